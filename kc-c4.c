@@ -1,15 +1,20 @@
 #include <stdio.h>
 #include <stdint.h>
-#include <zlib.h>
 #include "ketopt.h" // command-line argument parser
 #include "kthread.h" // multi-threading models: pipeline and multi-threaded for loop
+#include "kgz.h" // gzip reader that decompresses ahead on another thread
 
 #include "kseq.h" // FASTA/Q parser
-KSEQ_INIT(gzFile, gzread)
+KSEQ_INIT(kgz_t*, kgz_read)
+
+#include "knt4.h" // SIMD nucleotide encoder
 
 #include "khashl.h" // hash table
+#ifndef KC_BITS // override with -DKC_BITS=INT; see the kc-c4-c% rule in Makefile
 #define KC_BITS 10
+#endif
 #define KC_MAX ((1<<KC_BITS) - 1)
+#define KC_PF_DIST 16 // prefetch distance in worker_for()
 #define kc_c4_eq(a, b) ((a)>>KC_BITS == (b)>>KC_BITS) // lower 8 bits for counts; higher bits for k-mer
 #define kc_c4_hash(a) ((a)>>KC_BITS)
 KHASHL_SET_INIT(, kc_c4_t, kc_c4, uint64_t, kc_c4_hash, kc_c4_eq)
@@ -18,25 +23,6 @@ KHASHL_SET_INIT(, kc_c4_t, kc_c4, uint64_t, kc_c4_hash, kc_c4_eq)
 #define MALLOC(ptr, len) ((ptr) = (__typeof__(ptr))malloc((len) * sizeof(*(ptr))))
 #define REALLOC(ptr, len) ((ptr) = (__typeof__(ptr))realloc((ptr), (len) * sizeof(*(ptr))))
 
-const unsigned char seq_nt4_table[256] = { // translate ACGT to 0123
-	0, 1, 2, 3,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4
-};
-
 static inline uint64_t hash64(uint64_t key, uint64_t mask) // invertible integer hash function
 {
 	key = (~key + (key << 21)) & mask; // key = (key << 21) - key - 1;
@@ -84,25 +70,54 @@ static inline void c4x_insert_buf(buf_c4_t *buf, int p, uint64_t y) // insert a
 
 static void count_seq_buf(buf_c4_t *buf, int k, int p, int len, const char *seq) // insert k-mers in $seq to linear buffer $buf
 {
-	int i, l;
+	int i, j, l;
 	uint64_t x[2], mask = (1ULL<<k*2) - 1, shift = (k - 1) * 2;
-	for (i = l = 0, x[0] = x[1] = 0; i < len; ++i) {
-		int c = seq_nt4_table[(uint8_t)seq[i]];
-		if (c < 4) { // not an "N" base
-			x[0] = (x[0] << 2 | c) & mask;                  // forward strand
-			x[1] = x[1] >> 2 | (uint64_t)(3 - c) << shift;  // reverse strand
-			if (++l >= k) { // we find a k-mer
-				uint64_t y = x[0] < x[1]? x[0] : x[1];
+	for (i = l = 0, x[0] = x[1] = 0; i < len; i += 32) {
+		uint32_t amb;
+		uint64_t w = knt4_enc32(&seq[i], len - i, &amb); // 32 bases in 2-bit codes
+		int n = len - i < 32? len - i : 32;
+		if (amb == 0 && l >= k - 1) { // no "N" in this block and the first k-mer is complete
+			for (j = 0; j < n; ++j, w >>= 2) {
+				uint64_t y, c = w & 3;
+				x[0] = (x[0] << 2 | c) & mask;
+				x[1] = x[1] >> 2 | (3 - c) << shift;
+				y = x[0] < x[1]? x[0] : x[1];
 				c4x_insert_buf(buf, p, hash64(y, mask));
 			}
-		} else l = 0, x[0] = x[1] = 0; // if there is an "N", restart
+			l += n;
+			continue;
+		}
+		for (j = 0; j < n; ++j, w >>= 2, amb >>= 1) {
+			int c = w & 3;
+			if (!(amb & 1)) { // not an "N" base
+				x[0] = (x[0] << 2 | c) & mask;                  // forward strand
+				x[1] = x[1] >> 2 | (uint64_t)(3 - c) << shift;  // reverse strand
+				if (++l >= k) { // we find a k-mer
+					uint64_t y = x[0] < x[1]? x[0] : x[1];
+					c4x_insert_buf(buf, p, hash64(y, mask));
+				}
+			} else l = 0, x[0] = x[1] = 0; // if there is an "N", restart
+		}
 	}
 }
 
+#define KC_N_ARENA 4 // sequence arenas kept for reuse
+
+typedef struct { // arrays and sequence memory of a finished block, reused by the next one
+	int m;
+	int *len;
+	char **seq;
+	int64_t a_m;
+	char *a;
+} arena_t;
+
 typedef struct { // global data structure for kt_pipeline()
 	int k, block_len, n_thread;
 	kseq_t *ks;
 	kc_c4x_t *h;
+	volatile int ar_lock;
+	int n_ar;
+	arena_t ar[KC_N_ARENA]; // free list of arenas
 } pldat_t;
 
 typedef struct { // data structure for each step in kt_pipeline()
@@ -110,18 +125,69 @@ typedef struct { // data structure for each step in kt_pipeline()
 	int n, m, sum_len, nk;
 	int *len;
 	char **seq;
+	int64_t a_l, a_m;
+	char *a; // sequences back to back
 	buf_c4_t *buf;
 } stepdat_t;
 
+static void arena_get(stepdat_t *s) // take arrays and sequence memory from the free list, if any
+{
+	pldat_t *p = s->p;
+	while (__sync_lock_test_and_set(&p->ar_lock, 1)) {}
+	if (p->n_ar > 0) {
+		arena_t *r = &p->ar[--p->n_ar];
+		s->m = r->m, s->len = r->len, s->seq = r->seq, s->a_m = r->a_m, s->a = r->a;
+	}
+	__sync_lock_release(&p->ar_lock);
+}
+
+static void arena_put(stepdat_t *s) // return arrays and sequence memory to the free list, or free them if it is full
+{
+	pldat_t *p = s->p;
+	int full;
+	while (__sync_lock_test_and_set(&p->ar_lock, 1)) {}
+	if (!(full = (p->n_ar == KC_N_ARENA))) {
+		arena_t *r = &p->ar[p->n_ar++];
+		r->m = s->m, r->len = s->len, r->seq = s->seq, r->a_m = s->a_m, r->a = s->a;
+	}
+	__sync_lock_release(&p->ar_lock);
+	if (full) {
+		free(s->len); free(s->seq); free(s->a);
+	}
+}
+
+static void arena_push(stepdat_t *s, const char *seq, int l) // copy sequence $s->n to the arena
+{
+	if (s->a_l + l > s->a_m) { // move to a larger arena; the sequences so far point into the old one
+		int i;
+		int64_t m = s->a_l + l;
+		char *a;
+		m += m >> 1;
+		MALLOC(a, m);
+		if (s->a_l) memcpy(a, s->a, s->a_l);
+		for (i = 0; i < s->n; ++i)
+			s->seq[i] = a + (s->seq[i] - s->a);
+		free(s->a);
+		s->a = a, s->a_m = m;
+	}
+	s->seq[s->n] = s->a + s->a_l;
+	memcpy(s->seq[s->n], seq, l);
+	s->a_l += l;
+}
+
 static void worker_for(void *data, long i, int tid) // callback for kt_for()
 {
 	stepdat_t *s = (stepdat_t*)data;
 	buf_c4_t *b = &s->buf[i];
 	kc_c4_t *h = s->p->h->h[i];
 	int j, p = s->p->h->p;
+	for (j = 0; j < b->n && j < KC_PF_DIST; ++j)
+		kc_c4_prefetch(h, b->a[j]>>p<<KC_BITS);
 	for (j = 0; j < b->n; ++j) {
 		khint_t k;
 		int absent;
+		if (j + KC_PF_DIST < b->n) // fetch the bucket of a later k-mer while inserting this one
+			kc_c4_prefetch(h, b->a[j + KC_PF_DIST]>>p<<KC_BITS);
 		k = kc_c4_put(h, b->a[j]>>p<<KC_BITS, &absent);
 		if ((kh_key(h, k)&KC_MAX) < KC_MAX) ++kh_key(h, k);
 	}
@@ -135,6 +201,7 @@ static void *worker_pipeline(void *data, int step, void *in) // callback for kt_
 		stepdat_t *s;
 		CALLOC(s, 1);
 		s->p = p;
+		arena_get(s);
 		while ((ret = kseq_read(p->ks)) >= 0) {
 			int l = p->ks->seq.l;
 			if (l < p->k) continue;
@@ -143,16 +210,16 @@ static void *worker_pipeline(void *data, int step, void *in) // callback for kt_
 				REALLOC(s->len, s->m);
 				REALLOC(s->seq, s->m);
 			}
-			MALLOC(s->seq[s->n], l);
-			memcpy(s->seq[s->n], p->ks->seq.s, l);
+			arena_push(s, p->ks->seq.s, l);
 			s->len[s->n++] = l;
 			s->sum_len += l;
 			s->nk += l - p->k + 1;
 			if (s->sum_len >= p->block_len)
 				break;
 		}
-		if (s->sum_len == 0) free(s);
-		else return s;
+		if (s->sum_len > 0) return s;
+		arena_put(s);
+		free(s);
 	} else if (step == 1) { // step 2: extract k-mers
 		stepdat_t *s = (stepdat_t*)in;
 		int i, n = 1<<p->h->p, m;
@@ -162,11 +229,9 @@ static void *worker_pipeline(void *data, int step, void *in) // callback for kt_
 			s->buf[i].m = m;
 			MALLOC(s->buf[i].a, m);
 		}
-		for (i = 0; i < s->n; ++i) {
+		for (i = 0; i < s->n; ++i)
 			count_seq_buf(s->buf, p->k, p->h->p, s->len[i], s->seq[i]);
-			free(s->seq[i]);
-		}
-		free(s->seq); free(s->len);
+		arena_put(s);
 		return s;
 	} else if (step == 2) { // step 3: insert k-mers to hash table
 		stepdat_t *s = (stepdat_t*)in;
@@ -181,16 +246,21 @@ static void *worker_pipeline(void *data, int step, void *in) // callback for kt_
 static kc_c4x_t *count_file(const char *fn, int k, int p, int block_size, int n_thread)
 {
 	pldat_t pl;
-	gzFile fp;
-	if ((fp = gzopen(fn, "r")) == 0) return 0;
+	kgz_t *fp;
+	int i;
+	if ((fp = kgz_open(fn, n_thread)) == 0) return 0;
 	pl.ks = kseq_init(fp);
 	pl.k = k;
 	pl.n_thread = n_thread;
 	pl.h = c4x_init(p);
 	pl.block_len = block_size;
+	pl.ar_lock = pl.n_ar = 0;
 	kt_pipeline(3, worker_pipeline, &pl, 3);
+	for (i = 0; i < pl.n_ar; ++i) {
+		free(pl.ar[i].len); free(pl.ar[i].seq); free(pl.ar[i].a);
+	}
 	kseq_destroy(pl.ks);
-	gzclose(fp);
+	kgz_close(fp);
 	return pl.h;
 }
 
@@ -238,6 +308,7 @@ int main(int argc, char *argv[])
 	kc_c4x_t *h;
 	int i, c, k = 31, p = KC_BITS, block_size = 10000000, n_thread = 4;
 	ketopt_t o = KETOPT_INIT;
+	knt4_init();
 	while ((c = ketopt(&o, argc, argv, 1, "k:p:b:t:", 0)) >= 0) {
 		if (c == 'k') k = atoi(o.arg);
 		else if (c == 'p') p = atoi(o.arg);
@@ -253,8 +324,8 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "  -t INT     number of worker threads [%d]\n", n_thread);
 		return 1;
 	}
-	if (p < KC_BITS) {
-		fprintf(stderr, "ERROR: -p should be at least %d\n", KC_BITS);
+	if (p < k * 2 + KC_BITS - 64) { // a k-mer without its prefix and the counter must fit 64 bits
+		fprintf(stderr, "ERROR: -p should be at least %d\n", k * 2 + KC_BITS - 64);
 		return 1;
 	}
 	h = count_file(argv[o.ind], k, p, block_size, n_thread);
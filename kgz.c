@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "kthread.h"
+#include "kgz.h"
+
+#define KGZ_N_BUF  4       // batches in flight; the reader stays up to this many batches ahead
+#define KGZ_BATCH  (1<<22) // decompress at least 4MB at a time, unless at the end of file
+#define KGZ_HDR    12      // fixed part of a gzip header followed by the 2-byte extra length
+
+typedef struct {
+	int64_t l, m;
+	uint8_t *s;
+	int eof; // 1 at the end of file; -1 on errors
+} kgz_buf_t;
+
+typedef struct {
+	int64_t c_off, u_off; // offsets of compressed data in $cbuf and of its output in the batch
+	int32_t c_len, u_len;
+	uint32_t crc;
+} kgz_blk_t;
+
+struct kgz_s {
+	int n_threads, bgzf, stop; // no read-ahead thread if n_threads==1
+	FILE *fp; // with BGZF
+	gzFile gz; // without BGZF
+	pthread_t tid;
+	pthread_mutex_t lock;
+	pthread_cond_t cv;
+	kgz_buf_t buf[KGZ_N_BUF]; // a ring of decompressed batches
+	int64_t n_put, n_get, off; // batches produced; batches consumed; position in batch $n_get
+	int64_t c_l, c_m; // compressed blocks of the batch being decompressed
+	uint8_t *cbuf;
+	int n_blk, m_blk, err;
+	kgz_blk_t *blk;
+	kgz_buf_t *cur;
+	z_stream *zs; // one per thread
+};
+
+static inline uint32_t kgz_le32(const uint8_t *p) { return p[0] | p[1]<<8 | p[2]<<16 | (uint32_t)p[3]<<24; }
+
+static int kgz_bgzf_bsize(const uint8_t *x, int xlen) // find the BC subfield in the extra field; return BSIZE+1 or -1
+{
+	int i;
+	for (i = 0; i + 4 <= xlen; i += 4 + (x[i+2] | x[i+3]<<8))
+		if (x[i] == 'B' && x[i+1] == 'C' && (x[i+2] | x[i+3]<<8) == 2 && i + 6 <= xlen)
+			return (x[i+4] | x[i+5]<<8) + 1;
+	return -1;
+}
+
+static int kgz_test_bgzf(const char *fn) // only for regular files; the header of a pipe can't be read twice
+{
+	uint8_t h[KGZ_HDR + 256];
+	int n, xlen;
+	struct stat st;
+	FILE *fp;
+	if (stat(fn, &st) < 0 || !S_ISREG(st.st_mode)) return 0;
+	if ((fp = fopen(fn, "rb")) == 0) return 0;
+	n = fread(h, 1, sizeof(h), fp);
+	fclose(fp);
+	if (n < KGZ_HDR || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || !(h[3] & 4)) return 0;
+	xlen = h[10] | h[11]<<8;
+	return KGZ_HDR + xlen <= n && kgz_bgzf_bsize(&h[KGZ_HDR], xlen) > 0;
+}
+
+static void worker_inflate(void *data, long i, int tid) // callback for kt_for()
+{
+	kgz_t *fp = (kgz_t*)data;
+	const kgz_blk_t *b = &fp->blk[i];
+	z_stream *z = &fp->zs[tid];
+	uint8_t *out = fp->cur->s + b->u_off;
+	inflateReset(z);
+	z->next_in = fp->cbuf + b->c_off, z->avail_in = b->c_len;
+	z->next_out = out, z->avail_out = b->u_len;
+	if (inflate(z, Z_FINISH) != Z_STREAM_END || z->avail_out != 0 || crc32(crc32(0L, Z_NULL, 0), out, b->u_len) != b->crc)
+		fp->err = 1;
+}
+
+static int kgz_fill_bgzf(kgz_t *fp, kgz_buf_t *b) // read and inflate BGZF blocks of at least KGZ_BATCH bytes in total
+{
+	int64_t u_len = 0;
+	fp->c_l = fp->n_blk = 0, fp->err = 0;
+	while (u_len < KGZ_BATCH) {
+		uint8_t h[KGZ_HDR], x[256], *p;
+		int n, xlen, bsize;
+		kgz_blk_t *k;
+		if ((n = fread(h, 1, KGZ_HDR, fp->fp)) == 0) { b->eof = 1; break; }
+		if (n < KGZ_HDR || h[0] != 0x1f || h[1] != 0x8b || !(h[3] & 4)) return -1;
+		xlen = h[10] | h[11]<<8;
+		if (xlen > (int)sizeof(x) || fread(x, 1, xlen, fp->fp) != (size_t)xlen) return -1;
+		if ((bsize = kgz_bgzf_bsize(x, xlen)) < KGZ_HDR + xlen + 8) return -1;
+		n = bsize - KGZ_HDR - xlen; // compressed data, CRC32 and ISIZE
+		if (fp->c_l + n > fp->c_m) {
+			fp->c_m = fp->c_l + n + ((fp->c_l + n) >> 1);
+			fp->cbuf = (uint8_t*)realloc(fp->cbuf, fp->c_m);
+		}
+		p = fp->cbuf + fp->c_l;
+		if (fread(p, 1, n, fp->fp) != (size_t)n) return -1;
+		if (kgz_le32(p + n - 4) == 0) continue; // nothing to inflate, such as the EOF marker block
+		if (fp->n_blk == fp->m_blk) {
+			fp->m_blk = fp->m_blk? fp->m_blk << 1 : 256;
+			fp->blk = (kgz_blk_t*)realloc(fp->blk, fp->m_blk * sizeof(kgz_blk_t));
+		}
+		k = &fp->blk[fp->n_blk++];
+		k->c_off = fp->c_l, k->c_len = n - 8, k->u_off = u_len;
+		k->crc = kgz_le32(p + n - 8), k->u_len = kgz_le32(p + n - 4);
+		if (k->u_len > 65536) return -1;
+		fp->c_l += n, u_len += k->u_len;
+	}
+	if (u_len > b->m) {
+		b->m = u_len;
+		b->s = (uint8_t*)realloc(b->s, b->m);
+	}
+	fp->cur = b;
+	kt_for(fp->n_threads, worker_inflate, fp, fp->n_blk);
+	b->l = u_len;
+	return fp->err? -1 : 0;
+}
+
+static int kgz_fill_gz(kgz_t *fp, kgz_buf_t *b)
+{
+	if (b->m < KGZ_BATCH) {
+		b->m = KGZ_BATCH;
+		b->s = (uint8_t*)realloc(b->s, b->m);
+	}
+	for (b->l = 0; b->l < KGZ_BATCH;) {
+		int n = gzread(fp->gz, b->s + b->l, KGZ_BATCH - b->l);
+		if (n < 0) return -1;
+		if (n == 0) { b->eof = 1; break; }
+		b->l += n;
+	}
+	return 0;
+}
+
+static int kgz_fill(kgz_t *fp) // decompress the next batch; return its eof
+{
+	kgz_buf_t *b = &fp->buf[fp->n_put % KGZ_N_BUF]; // not seen by kgz_read() until $n_put is incremented
+	b->l = b->eof = 0;
+	if ((fp->bgzf? kgz_fill_bgzf(fp, b) : kgz_fill_gz(fp, b)) < 0) {
+		fprintf(stderr, "[E::%s] failed to decompress the input\n", __func__);
+		b->l = 0, b->eof = -1;
+	}
+	pthread_mutex_lock(&fp->lock);
+	++fp->n_put;
+	pthread_cond_broadcast(&fp->cv);
+	pthread_mutex_unlock(&fp->lock);
+	return b->eof;
+}
+
+static void *kgz_reader(void *data) // the read-ahead thread
+{
+	kgz_t *fp = (kgz_t*)data;
+	for (;;) {
+		pthread_mutex_lock(&fp->lock);
+		while (fp->n_put - fp->n_get >= KGZ_N_BUF && !fp->stop)
+			pthread_cond_wait(&fp->cv, &fp->lock);
+		pthread_mutex_unlock(&fp->lock);
+		if (fp->stop || kgz_fill(fp)) break;
+	}
+	return 0;
+}
+
+kgz_t *kgz_open(const char *fn, int n_threads)
+{
+	kgz_t *fp;
+	int i, is_stdin = strcmp(fn, "-") == 0;
+	fp = (kgz_t*)calloc(1, sizeof(kgz_t));
+	fp->n_threads = n_threads > 0? n_threads : 1;
+	fp->bgzf = !is_stdin && kgz_test_bgzf(fn);
+	if (fp->bgzf) {
+		if ((fp->fp = fopen(fn, "rb")) != 0) {
+			fp->zs = (z_stream*)calloc(fp->n_threads, sizeof(z_stream));
+			for (i = 0; i < fp->n_threads; ++i)
+				inflateInit2(&fp->zs[i], -15); // raw deflate
+		}
+	} else {
+		fp->gz = is_stdin? gzdopen(fileno(stdin), "r") : gzopen(fn, "r");
+		if (fp->gz) gzbuffer(fp->gz, 1<<20); // fewer and larger reads
+	}
+	if (fp->fp == 0 && fp->gz == 0) {
+		free(fp);
+		return 0;
+	}
+	pthread_mutex_init(&fp->lock, 0);
+	pthread_cond_init(&fp->cv, 0);
+	if (fp->n_threads > 1) pthread_create(&fp->tid, 0, kgz_reader, fp);
+	return fp;
+}
+
+int kgz_read(kgz_t *fp, void *buf, int len)
+{
+	int n = 0;
+	while (n < len) {
+		kgz_buf_t *b;
+		if (fp->n_threads == 1 && fp->n_get == fp->n_put) kgz_fill(fp); // no read-ahead with one thread
+		pthread_mutex_lock(&fp->lock);
+		while (fp->n_get == fp->n_put)
+			pthread_cond_wait(&fp->cv, &fp->lock);
+		pthread_mutex_unlock(&fp->lock);
+		b = &fp->buf[fp->n_get % KGZ_N_BUF];
+		if (fp->off < b->l) {
+			int l = b->l - fp->off < len - n? b->l - fp->off : len - n;
+			memcpy((uint8_t*)buf + n, b->s + fp->off, l);
+			fp->off += l, n += l;
+		} else if (b->eof) { // the last batch is kept so that later calls return here
+			return b->eof < 0 && n == 0? -1 : n;
+		} else {
+			pthread_mutex_lock(&fp->lock);
+			++fp->n_get, fp->off = 0;
+			pthread_cond_broadcast(&fp->cv);
+			pthread_mutex_unlock(&fp->lock);
+		}
+	}
+	return n;
+}
+
+void kgz_close(kgz_t *fp)
+{
+	int i;
+	if (fp == 0) return;
+	pthread_mutex_lock(&fp->lock);
+	fp->stop = 1;
+	pthread_cond_broadcast(&fp->cv);
+	pthread_mutex_unlock(&fp->lock);
+	if (fp->n_threads > 1) pthread_join(fp->tid, 0);
+	pthread_mutex_destroy(&fp->lock);
+	pthread_cond_destroy(&fp->cv);
+	if (fp->fp) fclose(fp->fp);
+	if (fp->gz) gzclose(fp->gz);
+	for (i = 0; fp->zs && i < fp->n_threads; ++i)
+		inflateEnd(&fp->zs[i]);
+	for (i = 0; i < KGZ_N_BUF; ++i)
+		free(fp->buf[i].s);
+	free(fp->zs); free(fp->cbuf); free(fp->blk); free(fp);
+}
@@ -0,0 +1,26 @@
+#ifndef KGZ_H
+#define KGZ_H
+
+/* A gzip reader that decompresses ahead of its caller on a separate thread.
+ * Blocks of a BGZF file (bgzip output) are independent and inflated in
+ * parallel; other gzip files and plain text go through zlib's gzread() on
+ * that thread. With one thread, kgz_read() decompresses when it runs out of
+ * data instead. kgz_read() works like gzread() and can be used with
+ * KSEQ_INIT().
+ */
+
+typedef struct kgz_s kgz_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+kgz_t *kgz_open(const char *fn, int n_threads); // "-" for stdin; NULL if the file can't be opened
+int kgz_read(kgz_t *fp, void *buf, int len); // read up to $len bytes; fewer only at the end of file; -1 on errors
+void kgz_close(kgz_t *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
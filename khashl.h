@@ -115,7 +115,8 @@ static kh_inline khint_t __kh_h2b(khint_t hash, khint_t bits) { return hash * 26
 	extern khint_t prefix##_getp(const HType *h, const khkey_t *key); \
 	extern int prefix##_resize(HType *h, khint_t new_n_buckets); \
 	extern khint_t prefix##_putp(HType *h, const khkey_t *key, int *absent); \
-	extern void prefix##_del(HType *h, khint_t k);
+	extern void prefix##_del(HType *h, khint_t k); \
+	extern void prefix##_prefetchp(const HType *h, const khkey_t *key);
 
 #define __KHASHL_IMPL_BASIC(SCOPE, HType, prefix) \
 	SCOPE HType *prefix##_init(void) { \
@@ -238,6 +239,15 @@ static kh_inline khint_t __kh_h2b(khint_t hash, khint_t bits) { return hash * 26
 		return 1; \
 	}
 
+#define __KHASHL_IMPL_PREFETCH(SCOPE, HType, prefix, khkey_t, __hash_fn) \
+	SCOPE void prefix##_prefetchp(const HType *h, const khkey_t *key) { /* bring the home bucket of $key into cache before a put or get */ \
+		khint_t i; \
+		if (h->keys == 0) return; \
+		i = __kh_h2b(__hash_fn(*key), h->bits); \
+		__builtin_prefetch(&h->keys[i], 1); \
+		__builtin_prefetch(&h->used[i>>5], 1); \
+	}
+
 #define KHASHL_DECLARE(HType, prefix, khkey_t) \
 	__KHASHL_TYPE(HType, khkey_t) \
 	__KHASHL_PROTOTYPES(HType, prefix, khkey_t)
@@ -248,7 +258,8 @@ static kh_inline khint_t __kh_h2b(khint_t hash, khint_t bits) { return hash * 26
 	__KHASHL_IMPL_GET(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
 	__KHASHL_IMPL_RESIZE(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
 	__KHASHL_IMPL_PUT(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
-	__KHASHL_IMPL_DEL(SCOPE, HType, prefix, khkey_t, __hash_fn)
+	__KHASHL_IMPL_DEL(SCOPE, HType, prefix, khkey_t, __hash_fn) \
+	__KHASHL_IMPL_PREFETCH(SCOPE, HType, prefix, khkey_t, __hash_fn)
 
 /*****************************
  * More convenient interface *
@@ -267,7 +278,8 @@ static kh_inline khint_t __kh_h2b(khint_t hash, khint_t bits) { return hash * 26
 	SCOPE void prefix##_resize(HType *h, khint_t new_n_buckets) { prefix##_s_resize(h, new_n_buckets); } \
 	SCOPE khint_t prefix##_get(const HType *h, khkey_t key) { HType##_s_bucket_t t; t.key = key; return prefix##_s_getp(h, &t); } \
 	SCOPE int prefix##_del(HType *h, khint_t k) { return prefix##_s_del(h, k); } \
-	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_s_bucket_t t; t.key = key; return prefix##_s_putp(h, &t, absent); }
+	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_s_bucket_t t; t.key = key; return prefix##_s_putp(h, &t, absent); } \
+	SCOPE void prefix##_prefetch(const HType *h, khkey_t key) { HType##_s_bucket_t t; t.key = key; prefix##_s_prefetchp(h, &t); }
 
 #define KHASHL_MAP_INIT(SCOPE, HType, prefix, khkey_t, kh_val_t, __hash_fn, __hash_eq) \
 	typedef struct { khkey_t key; kh_val_t val; } __kh_packed HType##_m_bucket_t; \
@@ -278,7 +290,8 @@ static kh_inline khint_t __kh_h2b(khint_t hash, khint_t bits) { return hash * 26
 	SCOPE void prefix##_destroy(HType *h) { prefix##_m_destroy(h); } \
 	SCOPE khint_t prefix##_get(const HType *h, khkey_t key) { HType##_m_bucket_t t; t.key = key; return prefix##_m_getp(h, &t); } \
 	SCOPE int prefix##_del(HType *h, khint_t k) { return prefix##_m_del(h, k); } \
-	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_m_bucket_t t; t.key = key; return prefix##_m_putp(h, &t, absent); }
+	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_m_bucket_t t; t.key = key; return prefix##_m_putp(h, &t, absent); } \
+	SCOPE void prefix##_prefetch(const HType *h, khkey_t key) { HType##_m_bucket_t t; t.key = key; prefix##_m_prefetchp(h, &t); }
 
 #define KHASHL_CSET_INIT(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
 	typedef struct { khkey_t key; khint_t hash; } __kh_packed HType##_cs_bucket_t; \
@@ -288,7 +301,8 @@ static kh_inline khint_t __kh_h2b(khint_t hash, khint_t bits) { return hash * 26
 	SCOPE void prefix##_destroy(HType *h) { prefix##_cs_destroy(h); } \
 	SCOPE khint_t prefix##_get(const HType *h, khkey_t key) { HType##_cs_bucket_t t; t.key = key; t.hash = __hash_fn(key); return prefix##_cs_getp(h, &t); } \
 	SCOPE int prefix##_del(HType *h, khint_t k) { return prefix##_cs_del(h, k); } \
-	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_cs_bucket_t t; t.key = key, t.hash = __hash_fn(key); return prefix##_cs_putp(h, &t, absent); }
+	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_cs_bucket_t t; t.key = key, t.hash = __hash_fn(key); return prefix##_cs_putp(h, &t, absent); } \
+	SCOPE void prefix##_prefetch(const HType *h, khkey_t key) { HType##_cs_bucket_t t; t.key = key, t.hash = __hash_fn(key); prefix##_cs_prefetchp(h, &t); }
 
 #define KHASHL_CMAP_INIT(SCOPE, HType, prefix, khkey_t, kh_val_t, __hash_fn, __hash_eq) \
 	typedef struct { khkey_t key; kh_val_t val; khint_t hash; } __kh_packed HType##_cm_bucket_t; \
@@ -298,7 +312,254 @@ static kh_inline khint_t __kh_h2b(khint_t hash, khint_t bits) { return hash * 26
 	SCOPE void prefix##_destroy(HType *h) { prefix##_cm_destroy(h); } \
 	SCOPE khint_t prefix##_get(const HType *h, khkey_t key) { HType##_cm_bucket_t t; t.key = key; t.hash = __hash_fn(key); return prefix##_cm_getp(h, &t); } \
 	SCOPE int prefix##_del(HType *h, khint_t k) { return prefix##_cm_del(h, k); } \
-	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_cm_bucket_t t; t.key = key, t.hash = __hash_fn(key); return prefix##_cm_putp(h, &t, absent); }
+	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_cm_bucket_t t; t.key = key, t.hash = __hash_fn(key); return prefix##_cm_putp(h, &t, absent); } \
+	SCOPE void prefix##_prefetch(const HType *h, khkey_t key) { HType##_cm_bucket_t t; t.key = key, t.hash = __hash_fn(key); prefix##_cm_prefetchp(h, &t); }
+
+/************************************************
+ * Hash table with SIMD-probed 7-bit hash tags *
+ ************************************************/
+
+/* This variant keeps the linear-probing layout of KHASHL_INIT, but adds a
+ * parallel byte array of tags: 0 for an empty bucket and 0x80|(hash&0x7f) for
+ * an occupied one. Lookups compare a group of 16 (SSE2) or 32 (AVX2) tags at
+ * a time and only touch keys whose tags match. The first __KH_GRP tags are
+ * mirrored at the end of the array such that a group never wraps around.
+ * kh_key(), kh_exist() and kh_end() work as with the other tables.
+ */
+
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define __KH_GRP_BITS 5
+static kh_inline khint32_t __kh_grp_match(const uint8_t *p, uint8_t t) {
+	return (khint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi8((char)t)));
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define __KH_GRP_BITS 4
+static kh_inline khint32_t __kh_grp_match(const uint8_t *p, uint8_t t) {
+	return (khint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8((char)t)));
+}
+#else /* SWAR fallback: 8 tags in a 64-bit word; assuming little-endian */
+#define __KH_GRP_BITS 3
+static kh_inline khint32_t __kh_grp_match(const uint8_t *p, uint8_t t) {
+	khint64_t x, y;
+	memcpy(&x, p, 8);
+	x ^= 0x0101010101010101ULL * t;
+	y = ~(((x & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL) | x | 0x7f7f7f7f7f7f7f7fULL); /* 0x80 at zero bytes */
+	return (khint32_t)((y >> 7) * 0x0102040810204080ULL >> 56);
+}
+#endif
+#define __KH_GRP (1U<<__KH_GRP_BITS)
+
+#define __kh_h2t(hash) ((uint8_t)(0x80U | ((hash) & 0x7fU)))
+#define __kh_set_tag(tags, n_buckets, i, t) do { \
+		(tags)[i] = (t); \
+		if ((i) < __KH_GRP) (tags)[(i) + (n_buckets)] = (t); \
+	} while (0)
+
+#define __KHASHL_TTYPE(HType, khkey_t) \
+	typedef struct HType { \
+		khint_t bits, count; \
+		khint32_t *used; \
+		khkey_t *keys; \
+		uint8_t *tags; \
+	} HType;
+
+#define __KHASHL_IMPL_TBASIC(SCOPE, HType, prefix) \
+	SCOPE HType *prefix##_init(void) { \
+		return (HType*)kcalloc(1, sizeof(HType)); \
+	} \
+	SCOPE void prefix##_destroy(HType *h) { \
+		if (!h) return; \
+		kfree((void *)h->keys); kfree(h->used); kfree(h->tags); \
+		kfree(h); \
+	} \
+	SCOPE void prefix##_clear(HType *h) { \
+		if (h && h->used) { \
+			uint32_t n_buckets = 1U << h->bits; \
+			memset(h->used, 0, __kh_fsize(n_buckets) * sizeof(khint32_t)); \
+			memset(h->tags, 0, n_buckets + __KH_GRP); \
+			h->count = 0; \
+		} \
+	}
+
+#define __KHASHL_IMPL_TGET(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	SCOPE khint_t prefix##_getp(const HType *h, const khkey_t *key) { \
+		khint_t i, n, n_buckets, mask, hash; \
+		uint8_t t; \
+		if (h->keys == 0) return 0; \
+		n_buckets = 1U << h->bits; \
+		mask = n_buckets - 1U; \
+		hash = __hash_fn(*key); \
+		t = __kh_h2t(hash); \
+		i = __kh_h2b(hash, h->bits); \
+		for (n = 0; n < n_buckets; n += __KH_GRP) { \
+			khint32_t m = __kh_grp_match(&h->tags[i], t), e = __kh_grp_match(&h->tags[i], 0); \
+			if (e) m &= (e & -e) - 1U; /* a key can't sit beyond the first empty bucket */ \
+			for (; m; m &= m - 1U) { \
+				khint_t j = (i + __builtin_ctz(m)) & mask; \
+				if (__hash_eq(h->keys[j], *key)) return j; \
+			} \
+			if (e) break; \
+			i = (i + __KH_GRP) & mask; \
+		} \
+		return n_buckets; \
+	} \
+	SCOPE khint_t prefix##_get(const HType *h, khkey_t key) { return prefix##_getp(h, &key); }
+
+#define __KHASHL_IMPL_TRESIZE(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	SCOPE int prefix##_resize(HType *h, khint_t new_n_buckets) { \
+		khint32_t *new_used = 0; \
+		uint8_t *new_tags = 0; \
+		khint_t j = 0, x = new_n_buckets, n_buckets, new_bits, new_mask; \
+		while ((x >>= 1) != 0) ++j; \
+		if (new_n_buckets & (new_n_buckets - 1)) ++j; \
+		new_bits = j > __KH_GRP_BITS? j : __KH_GRP_BITS; \
+		new_n_buckets = 1U << new_bits; \
+		if (h->count > (new_n_buckets>>1) + (new_n_buckets>>2)) return 0; /* requested size is too small */ \
+		new_used = (khint32_t*)kmalloc(__kh_fsize(new_n_buckets) * sizeof(khint32_t)); \
+		new_tags = (uint8_t*)kmalloc(new_n_buckets + __KH_GRP); \
+		if (!new_used || !new_tags) { kfree(new_used); kfree(new_tags); return -1; } /* not enough memory */ \
+		memset(new_used, 0, __kh_fsize(new_n_buckets) * sizeof(khint32_t)); \
+		memset(new_tags, 0, new_n_buckets + __KH_GRP); \
+		n_buckets = h->keys? 1U<<h->bits : 0U; \
+		if (n_buckets < new_n_buckets) { /* expand */ \
+			khkey_t *new_keys = (khkey_t*)krealloc((void*)h->keys, new_n_buckets * sizeof(khkey_t)); \
+			if (!new_keys) { kfree(new_used); kfree(new_tags); return -1; } \
+			h->keys = new_keys; \
+		} /* otherwise shrink */ \
+		new_mask = new_n_buckets - 1; \
+		for (j = 0; j != n_buckets; ++j) { \
+			khkey_t key; \
+			if (!__kh_used(h->used, j)) continue; \
+			key = h->keys[j]; \
+			__kh_set_unused(h->used, j); \
+			while (1) { /* kick-out process; the same as in KHASHL_INIT */ \
+				khint_t i, hash = __hash_fn(key); \
+				i = __kh_h2b(hash, new_bits); \
+				while (__kh_used(new_used, i)) i = (i + 1) & new_mask; \
+				__kh_set_used(new_used, i); \
+				__kh_set_tag(new_tags, new_n_buckets, i, __kh_h2t(hash)); \
+				if (i < n_buckets && __kh_used(h->used, i)) { /* kick out the existing element */ \
+					{ khkey_t tmp = h->keys[i]; h->keys[i] = key; key = tmp; } \
+					__kh_set_unused(h->used, i); /* mark it as deleted in the old hash table */ \
+				} else { /* write the element and jump out of the loop */ \
+					h->keys[i] = key; \
+					break; \
+				} \
+			} \
+		} \
+		if (n_buckets > new_n_buckets) /* shrink the hash table */ \
+			h->keys = (khkey_t*)krealloc((void *)h->keys, new_n_buckets * sizeof(khkey_t)); \
+		kfree(h->used); kfree(h->tags); /* free the working space */ \
+		h->used = new_used, h->tags = new_tags, h->bits = new_bits; \
+		return 0; \
+	}
+
+#define __KHASHL_IMPL_TPUT(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	SCOPE khint_t prefix##_putp(HType *h, const khkey_t *key, int *absent) { \
+		khint_t n_buckets, i, n, mask, hash; \
+		uint8_t t; \
+		n_buckets = h->keys? 1U<<h->bits : 0U; \
+		*absent = -1; \
+		if (h->count >= (n_buckets>>1) + (n_buckets>>2)) { /* rehashing */ \
+			if (prefix##_resize(h, n_buckets + 1U) < 0) \
+				return n_buckets; \
+			n_buckets = 1U<<h->bits; \
+		} \
+		mask = n_buckets - 1; \
+		hash = __hash_fn(*key); \
+		t = __kh_h2t(hash); \
+		i = __kh_h2b(hash, h->bits); \
+		for (n = 0; n < n_buckets; n += __KH_GRP) { \
+			khint32_t m = __kh_grp_match(&h->tags[i], t), e = __kh_grp_match(&h->tags[i], 0); \
+			if (e) m &= (e & -e) - 1U; \
+			for (; m; m &= m - 1U) { \
+				khint_t j = (i + __builtin_ctz(m)) & mask; \
+				if (__hash_eq(h->keys[j], *key)) { *absent = 0; return j; } /* Don't touch h->keys[j] if present */ \
+			} \
+			if (e) { /* not present at all; take the first empty bucket */ \
+				i = (i + __builtin_ctz(e)) & mask; \
+				h->keys[i] = *key; \
+				__kh_set_used(h->used, i); \
+				__kh_set_tag(h->tags, n_buckets, i, t); \
+				++h->count; \
+				*absent = 1; \
+				return i; \
+			} \
+			i = (i + __KH_GRP) & mask; \
+		} \
+		return n_buckets; /* unreachable given the 75% load limit */ \
+	} \
+	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { return prefix##_putp(h, &key, absent); }
+
+#define __KHASHL_IMPL_TDEL(SCOPE, HType, prefix, khkey_t, __hash_fn) \
+	SCOPE int prefix##_del(HType *h, khint_t i) { \
+		khint_t j = i, k, mask, n_buckets; \
+		if (h->keys == 0) return 0; \
+		n_buckets = 1U<<h->bits; \
+		mask = n_buckets - 1U; \
+		while (1) { \
+			j = (j + 1U) & mask; \
+			if (j == i || !__kh_used(h->used, j)) break; /* j==i only when the table is completely full */ \
+			k = __kh_h2b(__hash_fn(h->keys[j]), h->bits); \
+			if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) { \
+				h->keys[i] = h->keys[j]; \
+				__kh_set_tag(h->tags, n_buckets, i, h->tags[j]); \
+				i = j; \
+			} \
+		} \
+		__kh_set_unused(h->used, i); \
+		__kh_set_tag(h->tags, n_buckets, i, 0); \
+		--h->count; \
+		return 1; \
+	}
+
+#define __KHASHL_IMPL_TPREFETCH(SCOPE, HType, prefix, khkey_t, __hash_fn) \
+	SCOPE void prefix##_prefetchp(const HType *h, const khkey_t *key) { \
+		khint_t i; \
+		if (h->keys == 0) return; \
+		i = __kh_h2b(__hash_fn(*key), h->bits); \
+		__builtin_prefetch(&h->keys[i], 1); \
+		__builtin_prefetch(&h->used[i>>5], 1); \
+		__builtin_prefetch(&h->tags[i], 1); \
+	}
+
+#define KHASHL_TINIT(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	__KHASHL_TTYPE(HType, khkey_t) \
+	__KHASHL_IMPL_TBASIC(SCOPE, HType, prefix) \
+	__KHASHL_IMPL_TGET(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	__KHASHL_IMPL_TRESIZE(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	__KHASHL_IMPL_TPUT(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	__KHASHL_IMPL_TDEL(SCOPE, HType, prefix, khkey_t, __hash_fn) \
+	__KHASHL_IMPL_TPREFETCH(SCOPE, HType, prefix, khkey_t, __hash_fn)
+
+#define KHASHL_TSET_INIT(SCOPE, HType, prefix, khkey_t, __hash_fn, __hash_eq) \
+	typedef struct { khkey_t key; } __kh_packed HType##_ts_bucket_t; \
+	static kh_inline khint_t prefix##_ts_hash(HType##_ts_bucket_t x) { return __hash_fn(x.key); } \
+	static kh_inline int prefix##_ts_eq(HType##_ts_bucket_t x, HType##_ts_bucket_t y) { return __hash_eq(x.key, y.key); } \
+	KHASHL_TINIT(KH_LOCAL, HType, prefix##_ts, HType##_ts_bucket_t, prefix##_ts_hash, prefix##_ts_eq) \
+	SCOPE HType *prefix##_init(void) { return prefix##_ts_init(); } \
+	SCOPE void prefix##_destroy(HType *h) { prefix##_ts_destroy(h); } \
+	SCOPE void prefix##_resize(HType *h, khint_t new_n_buckets) { prefix##_ts_resize(h, new_n_buckets); } \
+	SCOPE khint_t prefix##_get(const HType *h, khkey_t key) { HType##_ts_bucket_t t; t.key = key; return prefix##_ts_getp(h, &t); } \
+	SCOPE int prefix##_del(HType *h, khint_t k) { return prefix##_ts_del(h, k); } \
+	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_ts_bucket_t t; t.key = key; return prefix##_ts_putp(h, &t, absent); } \
+	SCOPE void prefix##_prefetch(const HType *h, khkey_t key) { HType##_ts_bucket_t t; t.key = key; prefix##_ts_prefetchp(h, &t); }
+
+#define KHASHL_TMAP_INIT(SCOPE, HType, prefix, khkey_t, kh_val_t, __hash_fn, __hash_eq) \
+	typedef struct { khkey_t key; kh_val_t val; } __kh_packed HType##_tm_bucket_t; \
+	static kh_inline khint_t prefix##_tm_hash(HType##_tm_bucket_t x) { return __hash_fn(x.key); } \
+	static kh_inline int prefix##_tm_eq(HType##_tm_bucket_t x, HType##_tm_bucket_t y) { return __hash_eq(x.key, y.key); } \
+	KHASHL_TINIT(KH_LOCAL, HType, prefix##_tm, HType##_tm_bucket_t, prefix##_tm_hash, prefix##_tm_eq) \
+	SCOPE HType *prefix##_init(void) { return prefix##_tm_init(); } \
+	SCOPE void prefix##_destroy(HType *h) { prefix##_tm_destroy(h); } \
+	SCOPE khint_t prefix##_get(const HType *h, khkey_t key) { HType##_tm_bucket_t t; t.key = key; return prefix##_tm_getp(h, &t); } \
+	SCOPE int prefix##_del(HType *h, khint_t k) { return prefix##_tm_del(h, k); } \
+	SCOPE khint_t prefix##_put(HType *h, khkey_t key, int *absent) { HType##_tm_bucket_t t; t.key = key; return prefix##_tm_putp(h, &t, absent); } \
+	SCOPE void prefix##_prefetch(const HType *h, khkey_t key) { HType##_tm_bucket_t t; t.key = key; prefix##_tm_prefetchp(h, &t); }
 
 /**************************
  * Public macro functions *
@@ -0,0 +1,153 @@
+#ifndef KNT4_H
+#define KNT4_H
+
+/* Encode A/C/G/T (U for T; case-insensitive) to 0/1/2/3, 32 bases at a time.
+ * Base i goes to bits 2i and 2i+1 of a 64-bit word. Other characters get
+ * code 0 and set bit i of an ambiguity mask. With ASCII, ((c>>1)&3) maps
+ * A/C/G/T to 0/1/3/2, and XOR with itself shifted by 1 gives 0/1/2/3. The
+ * AVX2, SSE4.1 or scalar encoder is chosen at runtime. knt4_mask_lowq()
+ * replaces bases of low Phred+33 qualities with "N" in the same way.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint64_t (*knt4_enc32_f)(const uint8_t *s, uint32_t *amb);
+typedef int (*knt4_lowq_f)(char *s, const char *q, int n, int min_q);
+
+static inline uint64_t knt4_spread(uint32_t x) // move bit i to bit 2i
+{
+	uint64_t y = x;
+	y = (y | y << 16) & 0x0000FFFF0000FFFFULL;
+	y = (y | y << 8)  & 0x00FF00FF00FF00FFULL;
+	y = (y | y << 4)  & 0x0F0F0F0F0F0F0F0FULL;
+	y = (y | y << 2)  & 0x3333333333333333ULL;
+	y = (y | y << 1)  & 0x5555555555555555ULL;
+	return y;
+}
+
+static uint64_t knt4_enc32_scalar(const uint8_t *s, uint32_t *amb)
+{
+	int i;
+	uint64_t w = 0;
+	uint32_t m = 0;
+	for (i = 0; i < 32; ++i) {
+		int c = s[i], u = c & 0xdf, t = c >> 1 & 3;
+		if (u == 'A' || u == 'C' || u == 'G' || u == 'T' || u == 'U') w |= (uint64_t)(t ^ t >> 1) << i * 2;
+		else m |= 1U << i;
+	}
+	*amb = m;
+	return w;
+}
+
+static int knt4_lowq_scalar(char *s, const char *q, int n, int min_q) // return the number of masked bases
+{
+	int i, k = 0;
+	for (i = 0; i < n; ++i)
+		if (q[i] < min_q + 33) s[i] = 'N', ++k;
+	return k;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+__attribute__((target("sse4.1")))
+static uint64_t knt4_enc32_sse41(const uint8_t *s, uint32_t *amb)
+{
+	const __m128i m3 = _mm_set1_epi8(3), up = _mm_set1_epi8((char)0xdf);
+	uint32_t lo = 0, hi = 0, ok = 0;
+	int i;
+	for (i = 0; i < 2; ++i) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + i * 16)), u = _mm_and_si128(v, up), t, e;
+		e = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('A')), _mm_cmpeq_epi8(u, _mm_set1_epi8('C'))),
+						 _mm_or_si128(_mm_cmpeq_epi8(u, _mm_set1_epi8('G')), _mm_cmpeq_epi8(u, _mm_set1_epi8('T'))));
+		e = _mm_or_si128(e, _mm_cmpeq_epi8(u, _mm_set1_epi8('U')));
+		t = _mm_and_si128(_mm_srli_epi16(v, 1), m3);
+		t = _mm_and_si128(_mm_xor_si128(t, _mm_srli_epi16(t, 1)), e); // 0 for ambiguous bases
+		lo |= (uint32_t)_mm_movemask_epi8(_mm_slli_epi16(t, 7)) << i * 16;
+		hi |= (uint32_t)_mm_movemask_epi8(_mm_slli_epi16(t, 6)) << i * 16;
+		ok |= (uint32_t)_mm_movemask_epi8(e) << i * 16;
+	}
+	*amb = ~ok;
+	return knt4_spread(lo) | knt4_spread(hi) << 1;
+}
+
+__attribute__((target("avx2")))
+static uint64_t knt4_enc32_avx2(const uint8_t *s, uint32_t *amb)
+{
+	const __m256i m3 = _mm256_set1_epi8(3), up = _mm256_set1_epi8((char)0xdf);
+	__m256i v = _mm256_loadu_si256((const __m256i*)s), u = _mm256_and_si256(v, up), t, e;
+	uint32_t lo, hi;
+	e = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(u, _mm256_set1_epi8('A')), _mm256_cmpeq_epi8(u, _mm256_set1_epi8('C'))),
+						_mm256_or_si256(_mm256_cmpeq_epi8(u, _mm256_set1_epi8('G')), _mm256_cmpeq_epi8(u, _mm256_set1_epi8('T'))));
+	e = _mm256_or_si256(e, _mm256_cmpeq_epi8(u, _mm256_set1_epi8('U')));
+	t = _mm256_and_si256(_mm256_srli_epi16(v, 1), m3);
+	t = _mm256_and_si256(_mm256_xor_si256(t, _mm256_srli_epi16(t, 1)), e);
+	lo = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(t, 7));
+	hi = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(t, 6));
+	*amb = ~(uint32_t)_mm256_movemask_epi8(e);
+	return knt4_spread(lo) | knt4_spread(hi) << 1;
+}
+
+__attribute__((target("sse4.1")))
+static int knt4_lowq_sse41(char *s, const char *q, int n, int min_q)
+{
+	const __m128i t = _mm_set1_epi8((char)(min_q + 33)), nn = _mm_set1_epi8('N');
+	int i, k = 0;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i m = _mm_cmplt_epi8(_mm_loadu_si128((const __m128i*)(q + i)), t); // quality characters are below 128
+		if (_mm_movemask_epi8(m) == 0) continue;
+		k += __builtin_popcount(_mm_movemask_epi8(m));
+		_mm_storeu_si128((__m128i*)(s + i), _mm_blendv_epi8(_mm_loadu_si128((const __m128i*)(s + i)), nn, m));
+	}
+	return k + knt4_lowq_scalar(s + i, q + i, n - i, min_q);
+}
+
+__attribute__((target("avx2")))
+static int knt4_lowq_avx2(char *s, const char *q, int n, int min_q)
+{
+	const __m256i t = _mm256_set1_epi8((char)(min_q + 33)), nn = _mm256_set1_epi8('N');
+	int i, k = 0;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i m = _mm256_cmpgt_epi8(t, _mm256_loadu_si256((const __m256i*)(q + i)));
+		uint32_t b = _mm256_movemask_epi8(m);
+		if (b == 0) continue;
+		k += __builtin_popcount(b);
+		_mm256_storeu_si256((__m256i*)(s + i), _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i*)(s + i)), nn, m));
+	}
+	return k + knt4_lowq_scalar(s + i, q + i, n - i, min_q);
+}
+#endif
+
+static knt4_enc32_f knt4_enc32_func;
+static knt4_lowq_f knt4_lowq_func;
+
+static inline void knt4_init(void) // pick the encoder; call before starting threads
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) knt4_enc32_func = knt4_enc32_avx2, knt4_lowq_func = knt4_lowq_avx2;
+	else if (__builtin_cpu_supports("sse4.1")) knt4_enc32_func = knt4_enc32_sse41, knt4_lowq_func = knt4_lowq_sse41;
+	else knt4_enc32_func = knt4_enc32_scalar, knt4_lowq_func = knt4_lowq_scalar;
+#else
+	knt4_enc32_func = knt4_enc32_scalar, knt4_lowq_func = knt4_lowq_scalar;
+#endif
+}
+
+static inline uint64_t knt4_enc32(const char *s, int n, uint32_t *amb) // encode min(n,32) bases; missing bases are ambiguous
+{
+	if (n < 32) {
+		uint8_t b[32];
+		memset(b, 'N', 32);
+		memcpy(b, s, n > 0? n : 0);
+		return knt4_enc32_func(b, amb);
+	}
+	return knt4_enc32_func((const uint8_t*)s, amb);
+}
+
+static inline int knt4_mask_lowq(char *s, const char *q, int n, int min_q) // change bases with quality below $min_q to "N"; return the count
+{
+	return knt4_lowq_func(s, q, n, min_q);
+}
+
+#endif
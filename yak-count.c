@@ -3,42 +3,160 @@
  *********************/
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+/*** Memory allocation with huge pages ***/
+
+#define YAK_HUGE_SIZE  (1ULL<<21) // 2MB huge pages
+
+static inline void *yak_huge_advise(void *p, size_t z) // ask for transparent huge pages on the 2MB-aligned part of [p,p+z)
+{
+#ifdef MADV_HUGEPAGE
+	if (p && z >= YAK_HUGE_SIZE) {
+		uintptr_t st = ((uintptr_t)p + YAK_HUGE_SIZE - 1) & ~(YAK_HUGE_SIZE - 1), en = ((uintptr_t)p + z) & ~(YAK_HUGE_SIZE - 1);
+		if (st < en) madvise((void*)st, en - st, MADV_HUGEPAGE);
+	}
+#endif
+	return p;
+}
+
+static void *yak_malloc(size_t z)
+{
+	void *p = 0;
+	if (z < YAK_HUGE_SIZE) return malloc(z);
+	if (posix_memalign(&p, YAK_HUGE_SIZE, z) != 0) return 0;
+	return yak_huge_advise(p, z);
+}
+
+static void *yak_calloc(size_t n, size_t z)
+{
+	void *p = calloc(n, z); // large blocks come zeroed from mmap(); don't touch them before madvise()
+	return yak_huge_advise(p, n * z);
+}
+
+static inline void *yak_realloc(void *p, size_t z) { return yak_huge_advise(realloc(p, z), z); }
+
+#define kmalloc(Z)    yak_malloc(Z)
+#define kcalloc(N,Z)  yak_calloc(N,Z)
+#define krealloc(P,Z) yak_realloc(P,Z)
 #include "khashl.h"
 
-#define YAK_MAX_KMER     31
+#ifdef YAK_LONG_KMER // 128-bit k-mers; see the yak-count-long rule in Makefile
+typedef unsigned __int128 yak_kw_t; // a hashed k-mer, or a key with its counter
+#define YAK_MAX_KMER     64
+#else
+typedef uint64_t yak_kw_t;
+#define YAK_MAX_KMER     32
+#endif
+#define YAK_KW_BITS      ((int)sizeof(yak_kw_t) * 8)
+#ifndef YAK_COUNTER_BITS // override with -DYAK_COUNTER_BITS=INT; see the yak-count-c% rule in Makefile
 #define YAK_COUNTER_BITS 10
+#endif
+#if YAK_COUNTER_BITS < 1 || YAK_COUNTER_BITS > 20
+#error "YAK_COUNTER_BITS must be in [1,20]"
+#endif
 #define YAK_N_COUNTS     (1<<YAK_COUNTER_BITS)
 #define YAK_MAX_COUNT    ((1<<YAK_COUNTER_BITS)-1)
+#define YAK_SC_BITS      (YAK_COUNTER_BITS>>1) // with YAK_F_STRANDED, the counter bits hold a forward and a reverse counter of this size
+#define YAK_SC_MAX       ((1<<YAK_SC_BITS)-1)
 
 #define YAK_BLK_SHIFT  9 // 64 bytes, the size of a cache line
 #define YAK_BLK_MASK   ((1<<(YAK_BLK_SHIFT)) - 1)
 
+#define YAK_PF_DIST    16 // prefetch this many k-mers ahead when inserting
+
 #define yak_ch_eq(a, b) ((a)>>YAK_COUNTER_BITS == (b)>>YAK_COUNTER_BITS) // lower 8 bits for counts; higher bits for k-mer
 #define yak_ch_hash(a) ((a)>>YAK_COUNTER_BITS)
-KHASHL_SET_INIT(, yak_ht_t, yak_ht, uint64_t, yak_ch_hash, yak_ch_eq)
+#ifdef YAK_TAG_HT // probe 16/32 buckets at a time with SIMD tag comparisons; see khashl.h
+KHASHL_TSET_INIT(, yak_ht_t, yak_ht, yak_kw_t, yak_ch_hash, yak_ch_eq)
+#else
+KHASHL_SET_INIT(, yak_ht_t, yak_ht, yak_kw_t, yak_ch_hash, yak_ch_eq)
+#endif
+
+#define yak_ov_hash(a) ((khint_t)(a))
+KHASHL_MAP_INIT(KH_LOCAL, yak_ov_t, yak_ov, yak_kw_t, uint64_t, yak_ov_hash, kh_eq_generic)
+KHASHL_MAP_INIT(KH_LOCAL, yak_sm_t, yak_sm, uint64_t, uint32_t, kh_hash_uint64, kh_eq_generic)
+
+#define YAK_F_COMPACT  0x1 // store only the quotient remainders in the hash tables
+#define YAK_F_SATURATE 0x2 // no overflow table; counts stop at YAK_MAX_COUNT
+#define YAK_F_PRESIZE  0x4 // estimate the number of distinct k-mers before counting
+#define YAK_F_SHARED   0x8 // one table shared by all threads; k-mers are inserted right after extraction
+#define YAK_F_MINIMIZER 0x10 // sub-tables are indexed by minimizers, not k-mer hashes; keys keep all 2k bits; no lookups
+#define YAK_F_STRANDED 0x20 // separate counts for the two strands of a canonical k-mer; bit 2k of a hashed k-mer is set if it is on the reverse strand
+
+#define YAK_HLL_BITS   16 // 2^16 HyperLogLog registers; ~0.4% standard error
+#define YAK_SMP_MAX    65536 // max k-mers kept by a sampler
+#define YAK_SMP_PRE    16 // samplers watch this many prefixes
+
+#define YAK_MAX_NK     8 // max number of k-mer sizes counted in one pass
+
+#define yak_min_pre(k) ((k) * 2 + YAK_COUNTER_BITS - YAK_KW_BITS) // a k-mer without its prefix and the counter must fit a yak_kw_t
+
+typedef struct { // a spaced seed of up to 32 bases
+	int32_t span, n_run[2];
+	uint64_t m[2]; // bits taken from the forward and the reverse complement windows
+	uint64_t rm[2][32]; // for extraction without PEXT: each run of set bits in m[] and ...
+	int32_t rs[2][32]; // ... how far the run is shifted down
+} yak_seed_t;
 
 typedef struct {
+	int32_t flag;
 	int32_t bf_shift, bf_n_hash;
-	int32_t k;
+	int32_t n_k, k[YAK_MAX_NK]; // k-mer sizes; each gets its own hash table
 	int32_t pre;
+	int32_t mz; // minimizer length for super-k-mer partitioning; 0 to disable
+	int32_t min_q; // bases with Phred quality below this are treated as "N"
+	int32_t strand; // 0 for canonical k-mers; 1 for the forward strand only; 2 for both strands counted separately (YAK_F_STRANDED)
+	int32_t hpc; // collapse homopolymers before forming k-mers
+	yak_seed_t seed; // count spaced k-mers if seed.span > 0; k[0] is its weight
 	int32_t n_thread;
 	int64_t chunk_size;
+	int64_t n_est[YAK_MAX_NK]; // expected number of distinct k-mers per size; hash tables are allocated for it upfront
 } yak_copt_t;
 
 typedef struct {
 	int n_shift, n_hashes;
+	int hugetlb; // $b is mmap()'d from hugetlbfs
 	uint8_t *b;
 } yak_bf_t;
 
+typedef struct { // compact hash table; the bucket index is the lowest $bits bits of a key and not stored
+	int kb, bits, w, db; // key length in bits; log2(#slots); bytes per slot; bits for the probe distance
+	uint64_t count, n_max;
+	uint8_t *s; // each slot keeps [remainder|distance+1|counter] in $w bytes; distance+1==0 for an empty slot
+} yak_qt_t;
+
+typedef struct { // a segment of the shared table; any thread may update it with compare-and-swap
+	int bits;
+	volatile int lock; // protects the overflow table of the segment
+	uint64_t count;
+	uint64_t *a; // [key|counter] in each slot; 0 for an empty slot as a stored counter is at least 1; not owned
+} yak_ct_t;
+
+typedef struct { // bucketized cuckoo hash table for lookups only
+	int bits; // log2(#buckets)
+	int own; // $a is allocated by the table, not carved from a shared block
+	uint64_t count;
+	uint64_t *a; // YAK_CK_SLOTS [key|counter] words per bucket; 0 for an empty slot
+} yak_ck_t;
+
 typedef struct {
 	yak_ht_t *h;
+	yak_qt_t *q; // used in place of $h with YAK_F_COMPACT
+	yak_ct_t *c; // used in place of $h with YAK_F_SHARED
+	yak_ck_t *k; // replaces $h, $q or $c after yak_ch_cuckoo()
+	yak_ov_t *ov; // exact counts of k-mers saturated in $h or $q; allocated on demand
 	yak_bf_t *b;
 } yak_ch1_t;
 
 typedef struct {
-	int k, pre, n_hash, n_shift;
+	int k, pre, n_hash, n_shift, flag;
 	uint64_t tot;
 	yak_ch1_t *h;
+	uint64_t *ct; // slots of all segments of the shared table in one block, which can be backed by huge pages
+	uint64_t *ck; // buckets of all cuckoo tables in one block
+	size_t *ck_off; // offset of each cuckoo table in $ck
 } yak_ch_t;
 
 #define CALLOC(ptr, len) ((ptr) = (__typeof__(ptr))calloc((len), sizeof(*(ptr))))
@@ -57,35 +175,159 @@ static inline uint64_t yak_hash64(uint64_t key, uint64_t mask) // invertible int
 	return key;
 }
 
+static void yak_hash64_n_scalar(uint64_t *a, int n, uint64_t mask) // a[i] = yak_hash64(a[i], mask)
+{
+	int i;
+	for (i = 0; i < n; ++i)
+		a[i] = yak_hash64(a[i], mask);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static void yak_hash64_n_avx2(uint64_t *a, int n, uint64_t mask) // 4 k-mers at a time; the same steps as yak_hash64()
+{
+	const __m256i m = _mm256_set1_epi64x(mask), one = _mm256_set1_epi64x(-1);
+	int i;
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256i k = _mm256_loadu_si256((const __m256i*)(a + i));
+		k = _mm256_and_si256(_mm256_add_epi64(_mm256_xor_si256(k, one), _mm256_slli_epi64(k, 21)), m);
+		k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 24));
+		k = _mm256_and_si256(_mm256_add_epi64(_mm256_add_epi64(k, _mm256_slli_epi64(k, 3)), _mm256_slli_epi64(k, 8)), m);
+		k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 14));
+		k = _mm256_and_si256(_mm256_add_epi64(_mm256_add_epi64(k, _mm256_slli_epi64(k, 2)), _mm256_slli_epi64(k, 4)), m);
+		k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 28));
+		k = _mm256_and_si256(_mm256_add_epi64(k, _mm256_slli_epi64(k, 31)), m);
+		_mm256_storeu_si256((__m256i*)(a + i), k);
+	}
+	yak_hash64_n_scalar(a + i, n - i, mask);
+}
+
+__attribute__((target("avx512f")))
+static void yak_hash64_n_avx512(uint64_t *a, int n, uint64_t mask) // 8 k-mers at a time
+{
+	const __m512i m = _mm512_set1_epi64(mask), one = _mm512_set1_epi64(-1);
+	int i;
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m512i k = _mm512_loadu_si512((const void*)(a + i));
+		k = _mm512_and_si512(_mm512_add_epi64(_mm512_xor_si512(k, one), _mm512_slli_epi64(k, 21)), m);
+		k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 24));
+		k = _mm512_and_si512(_mm512_add_epi64(_mm512_add_epi64(k, _mm512_slli_epi64(k, 3)), _mm512_slli_epi64(k, 8)), m);
+		k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 14));
+		k = _mm512_and_si512(_mm512_add_epi64(_mm512_add_epi64(k, _mm512_slli_epi64(k, 2)), _mm512_slli_epi64(k, 4)), m);
+		k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 28));
+		k = _mm512_and_si512(_mm512_add_epi64(k, _mm512_slli_epi64(k, 31)), m);
+		_mm512_storeu_si512((void*)(a + i), k);
+	}
+	yak_hash64_n_avx2(a + i, n - i, mask);
+}
+#endif
+
+static void (*yak_hash64_n)(uint64_t *a, int n, uint64_t mask) = yak_hash64_n_scalar;
+
+void yak_hash_init(void) // pick the SIMD hash; call before starting threads
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) yak_hash64_n = yak_hash64_n_avx512;
+	else if (__builtin_cpu_supports("avx2")) yak_hash64_n = yak_hash64_n_avx2;
+#endif
+}
+
+#ifdef YAK_LONG_KMER
+static inline yak_kw_t yak_hash128(yak_kw_t key, yak_kw_t mask) // invertible; shifts beyond 64 bits mix the two halves
+{
+	const yak_kw_t c1 = (yak_kw_t)0x9e3779b97f4a7c15ULL << 64 | 0xf39cc0605cedc835ULL; // both odd
+	const yak_kw_t c2 = (yak_kw_t)0xc2b2ae3d27d4eb4fULL << 64 | 0x165667b19e3779f9ULL;
+	key = (~key + (key << 21)) & mask;
+	key = key ^ key >> 24;
+	key = (key * c1) & mask;
+	key = key ^ key >> 61;
+	key = (key * c2) & mask;
+	key = key ^ key >> 37;
+	key = (key * c1) & mask;
+	key = key ^ key >> 67;
+	return key;
+}
+static void yak_hash_n(yak_kw_t *a, int n, yak_kw_t mask)
+{
+	int i;
+	for (i = 0; i < n; ++i)
+		a[i] = yak_hash128(a[i], mask);
+}
+#define yak_hash(key, mask) yak_hash128(key, mask)
+#else
+#define yak_hash(key, mask) yak_hash64(key, mask)
+#define yak_hash_n(a, n, mask) yak_hash64_n(a, n, mask)
+#endif
+
 /*************************
  * From bbf.c and htab.c *
  *************************/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <assert.h>
 #include "kthread.h"
 
+int64_t yak_huge_mem(void) // bytes backed by transparent huge pages; -1 if unknown
+{
+	FILE *fp;
+	char buf[256];
+	int64_t z = -1;
+	if ((fp = fopen("/proc/self/smaps_rollup", "r")) == 0) return -1;
+	while (fgets(buf, 256, fp))
+		if (strncmp(buf, "AnonHugePages:", 14) == 0) {
+			z = atol(buf + 14) * 1024LL;
+			break;
+		}
+	fclose(fp);
+	return z;
+}
+
 /*** Blocked bloom filter ***/
 
 yak_bf_t *yak_bf_init(int n_shift, int n_hashes)
 {
 	yak_bf_t *b;
 	void *ptr = 0;
+	size_t z;
 	if (n_shift + YAK_BLK_SHIFT > 64 || n_shift < YAK_BLK_SHIFT) return 0;
 	b = calloc(1, sizeof(yak_bf_t));
 	b->n_shift = n_shift;
 	b->n_hashes = n_hashes;
-	posix_memalign(&ptr, 1<<(YAK_BLK_SHIFT-3), 1ULL<<(n_shift-3));
+	z = 1ULL<<(n_shift-3);
+#ifdef MAP_HUGETLB
+	if (z >= YAK_HUGE_SIZE) { // try pre-reserved huge pages first; mmap() returns zeroed memory
+		ptr = mmap(0, z, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED) b->hugetlb = 1;
+		else ptr = 0;
+	}
+#endif
+	if (ptr == 0) { // fall back to transparent huge pages
+		ptr = yak_malloc(z);
+		bzero(ptr, z);
+	}
 	b->b = ptr;
-	bzero(b->b, 1ULL<<(n_shift-3));
 	return b;
 }
 
 void yak_bf_destroy(yak_bf_t *b)
 {
 	if (b == 0) return;
-	free(b->b); free(b);
+	if (b->hugetlb) munmap(b->b, 1ULL<<(b->n_shift-3));
+	else free(b->b);
+	free(b);
+}
+
+static inline void yak_bf_prefetch(const yak_bf_t *b, uint64_t hash) // all probes of an insertion fall in the same cache line
+{
+	int x = b->n_shift - YAK_BLK_SHIFT;
+	uint64_t y = hash & ((1ULL<<x) - 1);
+	__builtin_prefetch(&b->b[y<<(YAK_BLK_SHIFT-3)], 1);
 }
 
 int yak_bf_insert(yak_bf_t *b, uint64_t hash)
@@ -107,401 +349,2295 @@ int yak_bf_insert(yak_bf_t *b, uint64_t hash)
 	return cnt;
 }
 
-/*** hash table ***/
+/*** HyperLogLog ***/
+
+typedef struct {
+	int p; // 2^p registers
+	uint8_t *r;
+} yak_hll_t;
 
-yak_ch_t *yak_ch_init(int k, int pre, int n_hash, int n_shift)
+yak_hll_t *yak_hll_init(int p)
 {
-	yak_ch_t *h;
-	int i;
-	if (pre < YAK_COUNTER_BITS) return 0;
+	yak_hll_t *h;
 	CALLOC(h, 1);
-	h->k = k, h->pre = pre;
-	CALLOC(h->h, 1<<h->pre);
-	for (i = 0; i < 1<<h->pre; ++i)
-		h->h[i].h = yak_ht_init();
-	if (n_hash > 0 && n_shift > h->pre) {
-		h->n_hash = n_hash, h->n_shift = n_shift;
-		for (i = 0; i < 1<<h->pre; ++i)
-			h->h[i].b = yak_bf_init(h->n_shift - h->pre, h->n_hash);
-	}
+	h->p = p;
+	CALLOC(h->r, 1U<<p);
 	return h;
 }
 
-void yak_ch_destroy_bf(yak_ch_t *h)
+void yak_hll_destroy(yak_hll_t *h)
 {
-	int i;
-	for (i = 0; i < 1<<h->pre; ++i) {
-		if (h->h[i].b)
-			yak_bf_destroy(h->h[i].b);
-		h->h[i].b = 0;
-	}
+	if (h == 0) return;
+	free(h->r); free(h);
 }
 
-void yak_ch_destroy(yak_ch_t *h)
+static inline void yak_hll_add(yak_hll_t *h, uint64_t x, int n_bits) // $x is a hash value with $n_bits random bits
 {
-	int i;
-	if (h == 0) return;
-	yak_ch_destroy_bf(h);
-	for (i = 0; i < 1<<h->pre; ++i)
-		yak_ht_destroy(h->h[i].h);
-	free(h->h); free(h);
+	uint64_t y = x >> h->p;
+	int r = y? __builtin_ctzll(y) + 1 : n_bits > h->p? n_bits - h->p + 1 : 1; // with 2k<=p, registers are only marked as seen
+	uint8_t *q = &h->r[x & ((1U<<h->p) - 1)];
+	if (r > *q) *q = r;
 }
 
-int yak_ch_insert_list(yak_ch_t *h, int create_new, int n, const uint64_t *a)
+void yak_hll_merge(yak_hll_t *h, const yak_hll_t *g)
 {
-	int j, mask = (1<<h->pre) - 1, n_ins = 0;
-	yak_ch1_t *g;
-	if (n == 0) return 0;
-	g = &h->h[a[0]&mask];
-	for (j = 0; j < n; ++j) {
-		int ins = 1, absent;
-		uint64_t x = a[j] >> h->pre;
-		khint_t k;
-		if ((a[j]&mask) != (a[0]&mask)) continue;
-		if (create_new) {
-			if (g->b)
-				ins = (yak_bf_insert(g->b, x) == h->n_hash);
-			if (ins) {
-				k = yak_ht_put(g->h, x<<YAK_COUNTER_BITS, &absent);
-				if (absent) ++n_ins;
-				if ((kh_key(g->h, k)&YAK_MAX_COUNT) < YAK_MAX_COUNT)
-					++kh_key(g->h, k);
-			}
-		} else {
-			k = yak_ht_get(g->h, x<<YAK_COUNTER_BITS);
-			if (k != kh_end(g->h) && (kh_key(g->h, k)&YAK_MAX_COUNT) < YAK_MAX_COUNT)
-				++kh_key(g->h, k);
-		}
-	}
-	return n_ins;
+	uint32_t i;
+	for (i = 0; i < 1U<<h->p; ++i)
+		if (g->r[i] > h->r[i]) h->r[i] = g->r[i];
 }
 
-int yak_ch_get(const yak_ch_t *h, uint64_t x)
+double yak_hll_est(const yak_hll_t *h)
 {
-	int mask = (1<<h->pre) - 1;
-	yak_ht_t *g = h->h[x&mask].h;
-	khint_t k;
-	k = yak_ht_get(g, x >> h->pre << YAK_COUNTER_BITS);
-	return k == kh_end(g)? -1 : kh_key(g, k)&YAK_MAX_COUNT;
+	uint32_t i, m = 1U<<h->p, n_zero = 0;
+	double sum = 0.0, e;
+	for (i = 0; i < m; ++i) {
+		sum += 1.0 / (1ULL << h->r[i]);
+		n_zero += (h->r[i] == 0);
+	}
+	e = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+	if (e <= 2.5 * m && n_zero > 0) e = m * log((double)m / n_zero); // linear counting for small cardinality
+	return e;
 }
 
-/*** Clear all counts to 0 ***/
+/*** adaptive k-mer sampling ***/
 
-static void worker_clear(void *data, long i, int tid) // callback for kt_for()
+typedef struct { // exact counts of k-mers whose lowest $level bits are all zero
+	int level;
+	yak_sm_t *h;
+} yak_smp_t;
+
+static void yak_smp_add(yak_smp_t *s, uint64_t x)
 {
-	yak_ch_t *h = (yak_ch_t*)data;
-	yak_ht_t *g = h->h[i].h;
+	int absent;
 	khint_t k;
-	uint64_t mask = ~1ULL >> YAK_COUNTER_BITS << YAK_COUNTER_BITS;
-	for (k = 0; k < kh_end(g); ++k)
-		if (kh_exist(g, k))
-			kh_key(g, k) &= mask;
+	if (x & ((1ULL<<s->level) - 1)) return;
+	if (s->h == 0) s->h = yak_sm_init();
+	k = yak_sm_put(s->h, x, &absent);
+	if (absent) kh_val(s->h, k) = 0;
+	++kh_val(s->h, k);
+	if (kh_size(s->h) > YAK_SMP_MAX) { // halve the sampling rate
+		yak_sm_t *f = yak_sm_init();
+		++s->level;
+		for (k = 0; k < kh_end(s->h); ++k) {
+			if (!kh_exist(s->h, k) || (kh_key(s->h, k) & ((1ULL<<s->level) - 1))) continue;
+			khint_t j = yak_sm_put(f, kh_key(s->h, k), &absent); // not inside kh_val(): f->keys may be read before the put allocates it
+			kh_val(f, j) = kh_val(s->h, k);
+		}
+		yak_sm_destroy(s->h);
+		s->h = f;
+	}
 }
 
-void yak_ch_clear(yak_ch_t *h, int n_thread)
+/*** compact hash table ***/
+
+/* A Robin Hood hash table with linear probing. As yak_hash64() is invertible,
+ * a key is as random as its hash. We use the lowest $bits bits as the bucket
+ * index and only keep the remaining bits in a slot, along with the distance to
+ * the bucket and the counter. For k=31, -p10 and 2^24 slots, a slot takes 6
+ * bytes, versus 8 bytes plus a used bit in khashl.
+ */
+
+#define YAK_QT_MIN_BITS 10
+#define YAK_QT_MIN_DB   5     // reserve at least 5 bits for the probe distance
+#define YAK_QT_LOAD     0.875 // Robin Hood hashing tolerates a higher load than khashl
+
+#define yak_qt_dist(q, v) ((v) >> YAK_COUNTER_BITS & ((1ULL<<(q)->db) - 1))
+#define yak_qt_cnt(q, i) (yak_qt_slot((q), (i)) & YAK_MAX_COUNT)
+
+static inline uint64_t yak_qt_slot(const yak_qt_t *q, uint64_t i) // assuming little-endian
 {
-	kt_for(n_thread, worker_clear, h, 1<<h->pre);
+	uint64_t v;
+	memcpy(&v, &q->s[i * q->w], 8);
+	return q->w == 8? v : v & ((1ULL<<q->w*8) - 1);
 }
 
-/*** generate histogram ***/
-
-typedef struct {
-	uint64_t c[YAK_N_COUNTS];
-} buf_cnt_t;
+static inline void yak_qt_set(yak_qt_t *q, uint64_t i, uint64_t v) // this also rewrites the following bytes with their original values
+{
+	uint8_t *p = &q->s[i * q->w];
+	if (q->w < 8) {
+		uint64_t u, m = (1ULL<<q->w*8) - 1;
+		memcpy(&u, p, 8);
+		v = (u & ~m) | v;
+	}
+	memcpy(p, &v, 8);
+}
 
-typedef struct {
-	const yak_ch_t *h;
-	buf_cnt_t *cnt;
-} hist_aux_t;
+static inline uint64_t yak_qt_key(const yak_qt_t *q, uint64_t i, uint64_t v) // recover the key at slot $i
+{
+	uint64_t mask = (1ULL<<q->bits) - 1;
+	return (v >> (YAK_COUNTER_BITS + q->db)) << q->bits | ((i - (yak_qt_dist(q, v) - 1)) & mask);
+}
 
-static void worker_hist(void *data, long i, int tid) // callback for kt_for()
+yak_qt_t *yak_qt_init(int kb)
 {
-	hist_aux_t *a = (hist_aux_t*)data;
-	uint64_t *cnt = a->cnt[tid].c;
-	yak_ht_t *g = a->h->h[i].h;
-	khint_t k;
-	for (k = 0; k < kh_end(g); ++k)
-		if (kh_exist(g, k))
-			++cnt[kh_key(g, k)&YAK_MAX_COUNT];
+	yak_qt_t *q;
+	CALLOC(q, 1);
+	q->kb = kb > 0? kb : 1; // with 2k<=pre, the prefix holds the whole k-mer
+	return q;
 }
 
-void yak_ch_hist(const yak_ch_t *h, int64_t cnt[YAK_N_COUNTS], int n_thread)
+void yak_qt_destroy(yak_qt_t *q)
 {
-	hist_aux_t a;
-	int i, j;
-	a.h = h;
-	memset(cnt, 0, YAK_N_COUNTS * sizeof(uint64_t));
-	CALLOC(a.cnt, n_thread);
-	kt_for(n_thread, worker_hist, &a, 1<<h->pre);
-	for (i = 0; i < YAK_N_COUNTS; ++i) cnt[i] = 0;
-	for (j = 0; j < n_thread; ++j)
-		for (i = 0; i < YAK_N_COUNTS; ++i)
-			cnt[i] += a.cnt[j].c[i];
-	free(a.cnt);
+	if (q == 0) return;
+	free(q->s); free(q);
 }
 
-/*** shrink a hash table ***/
+static void yak_qt_alloc(yak_qt_t *q, int bits) // allocate an empty table of 2^bits slots
+{
+	int nb;
+	if (bits > q->kb) bits = q->kb;
+	if (bits < q->kb + YAK_COUNTER_BITS + YAK_QT_MIN_DB - 64) bits = q->kb + YAK_COUNTER_BITS + YAK_QT_MIN_DB - 64;
+	nb = q->kb - bits + YAK_COUNTER_BITS; // remainder plus counter
+	q->bits = bits;
+	q->w = (nb + YAK_QT_MIN_DB + 7) / 8;
+	q->db = q->w * 8 - nb;
+	q->count = 0;
+	q->n_max = bits == q->kb? 1ULL<<bits : (uint64_t)((1ULL<<bits) * YAK_QT_LOAD);
+	q->s = (uint8_t*)yak_calloc(((size_t)1<<bits) * q->w + 8, 1); // 8 more bytes such that yak_qt_slot() can always read 8 bytes
+}
 
-typedef struct {
-	int min, max;
-	yak_ch_t *h;
-} shrink_aux_t;
+// Robin Hood insertion of a key known to be absent. Return the slot of $x, or -1 if a probe distance is too large to
+// be stored, in which case (*x,*c) is set to the element left out of the table.
+static int64_t yak_qt_insert1(yak_qt_t *q, uint64_t *x, uint64_t *c)
+{
+	uint64_t mask = (1ULL<<q->bits) - 1, dmax = (1ULL<<q->db) - 1;
+	uint64_t y = *x, cy = *c, i = y & mask, d = 1;
+	int64_t ret = -1;
+	for (;;) {
+		uint64_t v = yak_qt_slot(q, i), e = yak_qt_dist(q, v);
+		if (e < d) { // an empty slot (e==0) or a slot closer to its bucket; take it
+			yak_qt_set(q, i, (y >> q->bits) << (YAK_COUNTER_BITS + q->db) | d << YAK_COUNTER_BITS | cy);
+			if (ret < 0) ret = i;
+			if (e == 0) {
+				++q->count;
+				return ret;
+			}
+			y = yak_qt_key(q, i, v), cy = v & YAK_MAX_COUNT, d = e; // continue with the evicted element
+		}
+		i = (i + 1) & mask;
+		if (++d > dmax) {
+			*x = y, *c = cy;
+			return -1;
+		}
+	}
+}
 
-static void worker_shrink(void *data, long i, int tid) // callback for kt_for()
+static void yak_qt_resize(yak_qt_t *q, int bits)
 {
-	shrink_aux_t *a = (shrink_aux_t*)data;
-	yak_ch_t *h = a->h;
-	yak_ht_t *g = h->h[i].h, *f;
-	khint_t k;
-	f = yak_ht_init();
-	yak_ht_resize(f, kh_size(g));
-	for (k = 0; k < kh_end(g); ++k) {
-		if (kh_exist(g, k)) {
-			int absent, c = kh_key(g, k) & YAK_MAX_COUNT;
-			if (c >= a->min && c <= a->max)
-				yak_ht_put(f, kh_key(g, k), &absent);
+	yak_qt_t t;
+	uint64_t i, n = q->s? 1ULL<<q->bits : 0;
+	for (;; ++bits) {
+		t.kb = q->kb;
+		yak_qt_alloc(&t, bits);
+		for (i = 0; i < n; ++i) {
+			uint64_t v = yak_qt_slot(q, i), x, c;
+			if (yak_qt_dist(q, v) == 0) continue;
+			x = yak_qt_key(q, i, v), c = v & YAK_MAX_COUNT;
+			if (yak_qt_insert1(&t, &x, &c) < 0) break;
 		}
+		if (i == n) break;
+		free(t.s);
 	}
-	yak_ht_destroy(g);
-	h->h[i].h = f;
+	free(q->s);
+	*q = t;
 }
 
-void yak_ch_shrink(yak_ch_t *h, int min, int max, int n_thread)
+void yak_qt_reserve(yak_qt_t *q, uint64_t n) // make room for $n keys
 {
-	int i;
-	shrink_aux_t a;
-	a.h = h, a.min = min, a.max = max;
-	kt_for(n_thread, worker_shrink, &a, 1<<h->pre);
-	for (i = 0, h->tot = 0; i < 1<<h->pre; ++i)
-		h->tot += kh_size(h->h[i].h);
+	int bits = YAK_QT_MIN_BITS;
+	while (bits < q->kb && (uint64_t)((1ULL<<bits) * YAK_QT_LOAD) < n) ++bits;
+	if (q->s == 0 || bits > q->bits)
+		yak_qt_resize(q, bits);
 }
 
-/****************
- * From count.c *
- ****************/
+int64_t yak_qt_get(const yak_qt_t *q, uint64_t x) // return the slot of $x or -1 if absent
+{
+	uint64_t mask, i, d, rem;
+	if (q->s == 0) return -1;
+	mask = (1ULL<<q->bits) - 1, rem = x >> q->bits;
+	for (i = x & mask, d = 1;; i = (i + 1) & mask, ++d) {
+		uint64_t v = yak_qt_slot(q, i), e = yak_qt_dist(q, v);
+		if (e < d) return -1; // with Robin Hood hashing, $x would have taken this slot
+		if (e == d && v >> (YAK_COUNTER_BITS + q->db) == rem) return i;
+	}
+}
 
-#include <zlib.h>
-#include <string.h>
-#include "kseq.h" // FASTA/Q parser
-KSEQ_INIT(gzFile, gzread)
-
-unsigned char seq_nt4_table[256] = { // translate ACGT to 0123
-	0, 1, 2, 3,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-	4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4
-};
+int64_t yak_qt_put(yak_qt_t *q, uint64_t x, int *absent) // return the slot of $x; a new key comes with count 0
+{
+	uint64_t y = x, c = 0;
+	int64_t k;
+	if (q->s == 0) yak_qt_reserve(q, 0);
+	if ((k = yak_qt_get(q, x)) >= 0) {
+		*absent = 0;
+		return k;
+	}
+	*absent = 1;
+	if (q->count >= q->n_max) yak_qt_resize(q, q->bits + 1);
+	if ((k = yak_qt_insert1(q, &y, &c)) < 0) { // (y,c) is not necessarily (x,0)
+		do yak_qt_resize(q, q->bits + 1);
+		while (yak_qt_insert1(q, &y, &c) < 0);
+		k = yak_qt_get(q, x);
+	}
+	return k;
+}
 
-void yak_copt_init(yak_copt_t *o)
+static inline void yak_qt_prefetch(const yak_qt_t *q, uint64_t x)
 {
-	memset(o, 0, sizeof(yak_copt_t));
-	o->bf_shift = 0;
-	o->bf_n_hash = 4;
-	o->k = 31;
-	o->pre = 10;
-	o->n_thread = 4;
-	o->chunk_size = 10000000;
+	if (q->s) __builtin_prefetch(&q->s[(x & ((1ULL<<q->bits) - 1)) * q->w], 1);
 }
 
-typedef struct {
-	int n, m;
-	uint64_t n_ins;
-	uint64_t *a;
-} ch_buf_t;
+/*** concurrent hash table ***/
 
-static inline void ch_insert_buf(ch_buf_t *buf, int p, uint64_t y) // insert a k-mer $y to a linear buffer
+/* Linear probing on [key|counter] words. A new key is added by swapping an
+ * empty slot to [key|1] and a counter is incremented by swapping in v+1, so
+ * inserting threads need no locks. The key never moves once added, so
+ * resizing must be done when no thread is inserting; yak-count does that
+ * between chunks. All segments have the same size and are carved from one
+ * block; see yak_ch_grow().
+ */
+
+#define YAK_CT_MIN_BITS 8
+#define YAK_CT_LOAD     0.75
+#define YAK_CT_PF_DIST  64 // a power of 2; with extraction in between, the window is longer than YAK_PF_DIST
+
+static void yak_ct_rehash(yak_ct_t *c, uint64_t *a, int bits) // move keys in $c to empty slots $a[0..2^bits); not thread-safe
 {
-	int pre = y & ((1<<p) - 1);
-	ch_buf_t *b = &buf[pre];
-	if (b->n == b->m) {
-		b->m = b->m < 8? 8 : b->m + (b->m>>1);
-		REALLOC(b->a, b->m);
+	uint64_t i, mask = (1ULL<<bits) - 1;
+	for (i = 0; c->a && i < 1ULL<<c->bits; ++i) {
+		uint64_t j, v = c->a[i];
+		if (v == 0) continue;
+		for (j = v >> YAK_COUNTER_BITS & mask; a[j]; j = (j + 1) & mask) {}
+		a[j] = v;
 	}
-	b->a[b->n++] = y;
+	c->a = a, c->bits = bits;
 }
 
-static void count_seq_buf(ch_buf_t *buf, int k, int p, int len, const char *seq) // insert k-mers in $seq to linear buffer $buf
+int64_t yak_ct_get(const yak_ct_t *c, uint64_t x) // return the slot of $x or -1 if absent
 {
-	int i, l;
-	uint64_t x[2], mask = (1ULL<<k*2) - 1, shift = (k - 1) * 2;
-	for (i = l = 0, x[0] = x[1] = 0; i < len; ++i) {
-		int c = seq_nt4_table[(uint8_t)seq[i]];
-		if (c < 4) { // not an "N" base
-			x[0] = (x[0] << 2 | c) & mask;                  // forward strand
-			x[1] = x[1] >> 2 | (uint64_t)(3 - c) << shift;  // reverse strand
-			if (++l >= k) { // we find a k-mer
-				uint64_t y = x[0] < x[1]? x[0] : x[1];
-				ch_insert_buf(buf, p, yak_hash64(y, mask));
+	uint64_t i, mask = (1ULL<<c->bits) - 1;
+	for (i = x & mask;; i = (i + 1) & mask) {
+		uint64_t v = c->a[i];
+		if (v == 0) return -1;
+		if (v >> YAK_COUNTER_BITS == x) return i;
+	}
+}
+
+static int yak_ct_inc(yak_ct_t *c, uint64_t x, int create_new, int sh, uint64_t cm) // increment the counter cm<<sh; 1 if $x is added, 0 if incremented, -1 if saturated, -2 if absent
+{
+	uint64_t i, n, mask = (1ULL<<c->bits) - 1, y = x << YAK_COUNTER_BITS;
+	for (i = x & mask, n = 0; n <= mask; ) {
+		uint64_t v = __atomic_load_n(&c->a[i], __ATOMIC_RELAXED);
+		if (v == 0) {
+			if (!create_new) return -2;
+			if (__sync_bool_compare_and_swap(&c->a[i], 0, y | 1ULL<<sh)) {
+				__sync_fetch_and_add(&c->count, 1);
+				return 1;
 			}
-		} else l = 0, x[0] = x[1] = 0; // if there is an "N", restart
+			continue; // another thread has just taken the slot; look at it again
+		}
+		if (v >> YAK_COUNTER_BITS == x) {
+			while ((v >> sh & cm) < cm) {
+				uint64_t u = __sync_val_compare_and_swap(&c->a[i], v, v + (1ULL<<sh));
+				if (u == v) return 0;
+				v = u;
+			}
+			return -1;
+		}
+		i = (i + 1) & mask, ++n;
 	}
+	fprintf(stderr, "[E::%s] a segment of the shared table is full\n", __func__);
+	abort();
+	return -2;
 }
 
-typedef struct { // global data structure for kt_pipeline()
-	const yak_copt_t *opt;
-	int create_new;
-	kseq_t *ks;
-	yak_ch_t *h;
-} pldat_t;
+static inline void yak_ct_prefetch(const yak_ct_t *c, uint64_t x)
+{
+	__builtin_prefetch(&c->a[x & ((1ULL<<c->bits) - 1)], 1);
+}
 
-typedef struct { // data structure for each step in kt_pipeline()
-	pldat_t *p;
-	int n, m, sum_len, nk;
-	int *len;
-	char **seq;
-	ch_buf_t *buf;
-} stepdat_t;
+/*** bucketized cuckoo hash table ***/
 
-static void worker_for(void *data, long i, int tid) // callback for kt_for()
+/* Each key may live in one of two buckets and a bucket is a cache line of
+ * YAK_CK_SLOTS words, so a lookup reads at most two cache lines, present or
+ * absent. The table is built once from a finished count table.
+ */
+
+#define YAK_CK_SLOTS    8 // 64-byte buckets
+#define YAK_CK_LOAD     0.9
+#define YAK_CK_MAX_KICK 500
+
+#define yak_ck_b1(t, x) ((x) & ((1ULL<<(t)->bits) - 1))
+#define yak_ck_b2(t, x) (((x) * 0x9E3779B97F4A7C15ULL >> 32) & ((1ULL<<(t)->bits) - 1))
+
+static int yak_ck_insert1(yak_ck_t *t, uint64_t *v, uint64_t *r) // insert word *v; if failed, *v holds the word kicked out
 {
-	stepdat_t *s = (stepdat_t*)data;
-	ch_buf_t *b = &s->buf[i];
-	yak_ch_t *h = s->p->h;
-	b->n_ins += yak_ch_insert_list(h, s->p->create_new, b->n, b->a);
+	int i, j, kick;
+	uint64_t b = 1ULL<<t->bits;
+	for (kick = 0; kick < YAK_CK_MAX_KICK; ++kick) {
+		uint64_t x = *v >> YAK_COUNTER_BITS, c[2], *p;
+		c[0] = yak_ck_b1(t, x), c[1] = yak_ck_b2(t, x);
+		for (i = 0; i < 2; ++i)
+			for (j = 0, p = &t->a[c[i] * YAK_CK_SLOTS]; j < YAK_CK_SLOTS; ++j)
+				if (p[j] == 0) {
+					p[j] = *v;
+					return 0;
+				}
+		*r = *r * 6364136223846793005ULL + 1442695040888963407ULL; // LCG for random walk
+		i = c[0] == b? 1 : c[1] == b? 0 : *r >> 63; // don't go back to the bucket we just came from
+		p = &t->a[c[i] * YAK_CK_SLOTS + (*r >> 32) % YAK_CK_SLOTS];
+		x = *p, *p = *v, *v = x, b = c[i];
+	}
+	return -1;
 }
 
-static void *worker_pipeline(void *data, int step, void *in) // callback for kt_pipeline()
+static inline int yak_ck_bits(uint64_t n) // log2(#buckets) for $n keys
 {
-	pldat_t *p = (pldat_t*)data;
-	if (step == 0) { // step 1: read a block of sequences
-		int ret;
-		stepdat_t *s;
-		CALLOC(s, 1);
-		s->p = p;
-		while ((ret = kseq_read(p->ks)) >= 0) {
-			int l = p->ks->seq.l;
-			if (l < p->opt->k) continue;
-			if (s->n == s->m) {
-				s->m = s->m < 16? 16 : s->m + (s->n>>1);
-				REALLOC(s->len, s->m);
-				REALLOC(s->seq, s->m);
-			}
-			MALLOC(s->seq[s->n], l);
-			memcpy(s->seq[s->n], p->ks->seq.s, l);
-			s->len[s->n++] = l;
-			s->sum_len += l;
-			s->nk += l - p->opt->k + 1;
-			if (s->sum_len >= p->opt->chunk_size)
-				break;
-		}
-		if (s->sum_len == 0) free(s);
-		else return s;
-	} else if (step == 1) { // step 2: extract k-mers
-		stepdat_t *s = (stepdat_t*)in;
-		int i, n = 1<<p->opt->pre, m;
-		CALLOC(s->buf, n);
-		m = (int)(s->nk * 1.2 / n) + 1;
-		for (i = 0; i < n; ++i) {
-			s->buf[i].m = m;
-			MALLOC(s->buf[i].a, m);
-		}
-		for (i = 0; i < s->n; ++i) {
-			count_seq_buf(s->buf, p->opt->k, p->opt->pre, s->len[i], s->seq[i]);
-			free(s->seq[i]);
-		}
-		free(s->seq); free(s->len);
-		return s;
-	} else if (step == 2) { // step 3: insert k-mers to hash table
-		stepdat_t *s = (stepdat_t*)in;
-		int i, n = 1<<p->opt->pre;
-		uint64_t n_ins = 0;
-		kt_for(p->opt->n_thread, worker_for, s, n);
+	int bits = 0;
+	while ((double)((uint64_t)YAK_CK_SLOTS << bits) * YAK_CK_LOAD < n) ++bits;
+	return bits;
+}
+
+yak_ck_t *yak_ck_build(uint64_t n, const uint64_t *a, uint64_t *blk) // build from $n [key|counter] words, in $blk if not NULL
+{
+	yak_ck_t *t;
+	uint64_t i, r = 11;
+	CALLOC(t, 1);
+	t->bits = yak_ck_bits(n);
+	for (;;) {
+		size_t z = ((size_t)YAK_CK_SLOTS << t->bits) * sizeof(uint64_t);
+		if (blk) t->a = blk, t->own = 0;
+		else t->a = (uint64_t*)yak_malloc(z), t->own = 1; // yak_malloc() aligns large blocks to 2MB; otherwise buckets may straddle cache lines
+		memset(t->a, 0, z);
 		for (i = 0; i < n; ++i) {
-			n_ins += s->buf[i].n_ins;
-			free(s->buf[i].a);
+			uint64_t v = a[i];
+			if (yak_ck_insert1(t, &v, &r) < 0) break;
 		}
-		p->h->tot += n_ins;
-		free(s->buf);
-		fprintf(stderr, "[M] processed %d sequences; %ld distinct k-mers in the hash table\n", s->n, (long)p->h->tot);
-		free(s);
+		if (i == n) break;
+		if (t->own) free(t->a); // a word can't find a place; retry with twice as many buckets
+		blk = 0, ++t->bits;
 	}
-	return 0;
+	t->count = n;
+	return t;
 }
 
-yak_ch_t *yak_count(const char *fn, const yak_copt_t *opt, yak_ch_t *h0)
+void yak_ck_destroy(yak_ck_t *t)
 {
-	pldat_t pl;
-	gzFile fp;
-	if ((fp = gzopen(fn, "r")) == 0) return 0;
-	pl.ks = kseq_init(fp);
-	pl.opt = opt;
-	if (h0) {
-		pl.h = h0, pl.create_new = 0;
-		assert(h0->k == opt->k && h0->pre == opt->pre);
-	} else {
-		pl.create_new = 1;
-		pl.h = yak_ch_init(opt->k, opt->pre, opt->bf_n_hash, opt->bf_shift);
-	}
-	kt_pipeline(3, worker_pipeline, &pl, 3);
-	kseq_destroy(pl.ks);
-	gzclose(fp);
-	return pl.h;
+	if (t == 0) return;
+	if (t->own) free(t->a);
+	free(t);
 }
 
-yak_ch_t *yak_count_file(const char *fn1, const char *fn2, const yak_copt_t *opt)
+static inline int64_t yak_ck_get(const yak_ck_t *t, uint64_t x) // return the slot of $x or -1 if absent
 {
-	yak_ch_t *h;
-	h = yak_count(fn1, opt, 0); // if bloom filter is in use, this gets approximate counts
-	if (opt->bf_shift > 0) { // bloom filter is in use
-		yak_ch_destroy_bf(h); // deallocate bloom filter
-		yak_ch_clear(h, opt->n_thread); // set counts to 0
-		h = yak_count(fn2? fn2 : fn1, opt, h); // count again
-		yak_ch_shrink(h, 2, YAK_MAX_COUNT, opt->n_thread); // drop singleton k-mers caused by false positives in bloom filter
+	uint64_t i, j, c[2];
+	c[0] = yak_ck_b1(t, x), c[1] = yak_ck_b2(t, x);
+	for (i = 0; i < 2; ++i) {
+		const uint64_t *p = &t->a[c[i] * YAK_CK_SLOTS];
+		int empty = 0;
+		for (j = 0; j < YAK_CK_SLOTS; ++j) {
+			if (p[j] >> YAK_COUNTER_BITS == x && p[j]) return c[i] * YAK_CK_SLOTS + j;
+			empty |= p[j] == 0;
+		}
+		if (empty) break; // a key goes to its 2nd bucket only if the 1st is full; a bucket never loses keys
 	}
-	return h;
+	return -1;
 }
 
-#include "ketopt.h"
-
-int main(int argc, char *argv[])
+static inline void yak_ck_prefetch(const yak_ck_t *t, uint64_t x) // only the 1st bucket; fetching both halves the effective window
 {
-	yak_ch_t *h;
-	int c;
-	yak_copt_t opt;
+	__builtin_prefetch(&t->a[yak_ck_b1(t, x) * YAK_CK_SLOTS]);
+}
+
+/*** hash table ***/
+
+yak_ch_t *yak_ch_init(int k, int pre, int n_hash, int n_shift, int flag)
+{
+	yak_ch_t *h;
+	int i;
+	if (pre < 0 || ((flag & YAK_F_MINIMIZER)? k * 2 + (pre > YAK_COUNTER_BITS? pre : YAK_COUNTER_BITS) > YAK_KW_BITS : pre < yak_min_pre(k))) return 0;
+	if ((flag & YAK_F_MINIMIZER) && (flag & YAK_F_SHARED)) return 0;
+	if ((flag & YAK_F_STRANDED) && ((flag & YAK_F_MINIMIZER) || k * 2 >= YAK_KW_BITS || YAK_SC_BITS < 1)) return 0; // no room for the strand bit
+	if (YAK_KW_BITS > 64 && (flag & (YAK_F_COMPACT|YAK_F_SHARED))) return 0; // these tables keep 64-bit words
+	CALLOC(h, 1);
+	h->k = k, h->pre = pre, h->flag = flag;
+	CALLOC(h->h, 1<<h->pre);
+	for (i = 0; i < 1<<h->pre; ++i) {
+		if (flag & YAK_F_SHARED) CALLOC(h->h[i].c, 1);
+		else if (flag & YAK_F_COMPACT) h->h[i].q = yak_qt_init(flag & YAK_F_MINIMIZER? k * 2 : k * 2 - pre);
+		else h->h[i].h = yak_ht_init();
+	}
+	if (flag & YAK_F_SHARED) {
+		h->ct = (uint64_t*)yak_calloc((size_t)1<<(pre + YAK_CT_MIN_BITS), sizeof(uint64_t));
+		for (i = 0; i < 1<<h->pre; ++i)
+			h->h[i].c->a = &h->ct[(size_t)i<<YAK_CT_MIN_BITS], h->h[i].c->bits = YAK_CT_MIN_BITS;
+	} else if (n_hash > 0 && n_shift > h->pre) {
+		h->n_hash = n_hash, h->n_shift = n_shift;
+		for (i = 0; i < 1<<h->pre; ++i)
+			h->h[i].b = yak_bf_init(h->n_shift - h->pre, h->n_hash);
+	}
+	return h;
+}
+
+void yak_ch_destroy_bf(yak_ch_t *h)
+{
+	int i;
+	for (i = 0; i < 1<<h->pre; ++i) {
+		if (h->h[i].b)
+			yak_bf_destroy(h->h[i].b);
+		h->h[i].b = 0;
+	}
+}
+
+void yak_ch_destroy(yak_ch_t *h)
+{
+	int i;
+	if (h == 0) return;
+	yak_ch_destroy_bf(h);
+	for (i = 0; i < 1<<h->pre; ++i) {
+		yak_ht_destroy(h->h[i].h);
+		yak_qt_destroy(h->h[i].q);
+		free(h->h[i].c);
+		yak_ck_destroy(h->h[i].k);
+		yak_ov_destroy(h->h[i].ov);
+	}
+	free(h->ct); free(h->ck); free(h->ck_off); free(h->h); free(h);
+}
+
+static inline uint64_t yak_ch1_size(const yak_ch1_t *g)
+{
+	return g->k? g->k->count : g->c? g->c->count : g->q? g->q->count : kh_size(g->h);
+}
+
+static inline yak_kw_t yak_ch_key(const yak_ch_t *h, yak_kw_t y) // the key of hashed k-mer $y without the prefix and the strand bit
+{
+	yak_kw_t x = y >> h->pre;
+	if (h->flag & YAK_F_STRANDED) x &= ((yak_kw_t)1 << (h->k * 2 - h->pre)) - 1;
+	return x;
+}
+
+static inline void yak_ch_prefetch(const yak_ch_t *h, const yak_ch1_t *g, int create_new, yak_kw_t y)
+{
+	yak_kw_t x = yak_ch_key(h, y);
+	if (create_new && g->b) yak_bf_prefetch(g->b, (uint64_t)x);
+	if (g->c) yak_ct_prefetch(g->c, x);
+	else if (g->q) yak_qt_prefetch(g->q, x);
+	else yak_ht_prefetch(g->h, x<<YAK_COUNTER_BITS);
+}
+
+static void yak_ch1_inc_ov(yak_ch1_t *g, yak_kw_t x, int64_t c) // the counter of $x is saturated at $c; keep counting in the overflow table
+{
+	int absent;
+	khint_t k;
+	if (g->ov == 0) g->ov = yak_ov_init();
+	k = yak_ov_put(g->ov, x, &absent);
+	if (absent) kh_val(g->ov, k) = c;
+	++kh_val(g->ov, k);
+}
+
+static inline int64_t yak_ch1_count(const yak_ch1_t *g, yak_kw_t x, int c) // the exact count of $x given its counter $c
+{
+	khint_t k;
+	if (c < YAK_MAX_COUNT || g->ov == 0) return c;
+	k = yak_ov_get(g->ov, x);
+	return k == kh_end(g->ov)? c : (int64_t)kh_val(g->ov, k);
+}
+
+static inline int64_t yak_ch1_count_s(const yak_ch1_t *g, yak_kw_t x, int c, int s) // with YAK_F_STRANDED, the exact count of $x on strand $s
+{
+	khint_t k;
+	c = c >> s * YAK_SC_BITS & YAK_SC_MAX;
+	if (c < YAK_SC_MAX || g->ov == 0) return c;
+	k = yak_ov_get(g->ov, x << 1 | s); // saturated strands are kept apart in the overflow table
+	return k == kh_end(g->ov)? c : (int64_t)kh_val(g->ov, k);
+}
+
+static inline int64_t yak_ch_count(const yak_ch_t *h, const yak_ch1_t *g, yak_kw_t x, int c) // the exact count of $x in sub-table $g given its counter bits $c
+{
+	if (h->flag & YAK_F_STRANDED) return yak_ch1_count_s(g, x, c, 0) + yak_ch1_count_s(g, x, c, 1);
+	return yak_ch1_count(g, x, c);
+}
+
+static inline int yak_ch1_inc(yak_ch1_t *g, int create_new, int flag, yak_kw_t x, int s) // increment the count of $x on strand $s; return 1 if $x is added
+{
+	int absent = 0, sh = 0, saturate = flag & YAK_F_SATURATE;
+	uint64_t cm = YAK_MAX_COUNT;
+	yak_kw_t xo = x; // key in the overflow table
+	if (flag & YAK_F_STRANDED) sh = s * YAK_SC_BITS, cm = YAK_SC_MAX, xo = x << 1 | s;
+	if (g->c) {
+		int r = yak_ct_inc(g->c, x, create_new, sh, cm);
+		if (r == -1 && !saturate) {
+			while (__sync_lock_test_and_set(&g->c->lock, 1)) {}
+			yak_ch1_inc_ov(g, xo, cm);
+			__sync_lock_release(&g->c->lock);
+		}
+		absent = r == 1;
+	} else if (g->q) {
+		int64_t k = create_new? yak_qt_put(g->q, x, &absent) : yak_qt_get(g->q, x);
+		if (k >= 0) {
+			uint64_t v = yak_qt_slot(g->q, k);
+			if ((v >> sh & cm) < cm) yak_qt_set(g->q, k, v + (1ULL<<sh));
+			else if (!saturate) yak_ch1_inc_ov(g, xo, cm);
+		}
+	} else {
+		khint_t k = create_new? yak_ht_put(g->h, x<<YAK_COUNTER_BITS, &absent) : yak_ht_get(g->h, x<<YAK_COUNTER_BITS);
+		if (k != kh_end(g->h)) {
+			if ((kh_key(g->h, k) >> sh & cm) < cm) kh_key(g->h, k) += (yak_kw_t)1 << sh;
+			else if (!saturate) yak_ch1_inc_ov(g, xo, cm);
+		}
+	}
+	return absent > 0;
+}
+
+int yak_ch_insert_list(yak_ch_t *h, int create_new, int n, const yak_kw_t *a)
+{
+	int j, mask = (1<<h->pre) - 1, n_ins = 0;
+	yak_ch1_t *g;
+	if (n == 0) return 0;
+	g = &h->h[a[0]&mask];
+	for (j = 0; j < n && j < YAK_PF_DIST; ++j) // the bucket of a[j] is fetched while a[j-YAK_PF_DIST] is being inserted
+		yak_ch_prefetch(h, g, create_new, a[j]);
+	for (j = 0; j < n; ++j) {
+		yak_kw_t x = yak_ch_key(h, a[j]);
+		int s = (h->flag & YAK_F_STRANDED) && (a[j] >> h->k * 2 & 1);
+		if (j + YAK_PF_DIST < n)
+			yak_ch_prefetch(h, g, create_new, a[j + YAK_PF_DIST]);
+		if ((a[j]&mask) != (a[0]&mask)) continue;
+		if (create_new && g->b && yak_bf_insert(g->b, (uint64_t)x) != h->n_hash)
+			continue; // not seen before according to the bloom filter
+		n_ins += yak_ch1_inc(g, create_new, h->flag, x, s);
+	}
+	return n_ins;
+}
+
+int64_t yak_ch_get(const yak_ch_t *h, yak_kw_t x) // count of hashed k-mer x, or -1 if absent; always -1 on YAK_F_MINIMIZER tables
+{
+	int mask = (1<<h->pre) - 1;
+	const yak_ch1_t *g;
+	if (h->flag & YAK_F_MINIMIZER) return -1; // the sub-table is picked by the minimizer, which can't be derived from x
+	g = &h->h[x&mask];
+	x >>= h->pre;
+	if (g->k) {
+		int64_t k = yak_ck_get(g->k, x);
+		return k < 0? -1 : yak_ch_count(h, g, x, g->k->a[k] & YAK_MAX_COUNT);
+	} else if (g->c) {
+		int64_t k = yak_ct_get(g->c, x);
+		return k < 0? -1 : yak_ch_count(h, g, x, g->c->a[k] & YAK_MAX_COUNT);
+	} else if (g->q) {
+		int64_t k = yak_qt_get(g->q, x);
+		return k < 0? -1 : yak_ch_count(h, g, x, yak_qt_cnt(g->q, k));
+	} else {
+		khint_t k;
+		k = yak_ht_get(g->h, x << YAK_COUNTER_BITS);
+		return k == kh_end(g->h)? -1 : yak_ch_count(h, g, x, kh_key(g->h, k)&YAK_MAX_COUNT);
+	}
+}
+
+uint64_t yak_ch_mem(const yak_ch_t *h) // bytes taken by the hash tables
+{
+	uint64_t i, m = 0;
+	for (i = 0; i < 1U<<h->pre; ++i) {
+		const yak_ch1_t *g = &h->h[i];
+		if (g->k) m += ((uint64_t)YAK_CK_SLOTS << g->k->bits) * sizeof(uint64_t);
+		else if (g->c) m += ((uint64_t)1<<g->c->bits) * sizeof(uint64_t);
+		else if (g->q) m += g->q->s? ((uint64_t)1<<g->q->bits) * g->q->w : 0;
+		else m += kh_capacity(g->h) * sizeof(yak_kw_t) + (kh_capacity(g->h) >> 3);
+		if (g->ov) m += kh_capacity(g->ov) * sizeof(yak_ov_t_m_bucket_t) + (kh_capacity(g->ov) >> 3);
+	}
+	return m;
+}
+
+/*** Reserve space ***/
+
+typedef struct {
+	yak_ch_t *h;
+	uint64_t n;
+} reserve_aux_t;
+
+static void worker_reserve(void *data, long i, int tid) // callback for kt_for()
+{
+	reserve_aux_t *a = (reserve_aux_t*)data;
+	yak_ch1_t *g = &a->h->h[i];
+	if (g->q) yak_qt_reserve(g->q, a->n);
+	else if (kh_capacity(g->h) * 3 / 4 <= a->n) // khashl doubles at 75% load
+		yak_ht_resize(g->h, a->n + a->n / 3 + 1);
+}
+
+void yak_ch_grow(yak_ch_t *h, uint64_t n) // make room for $n more k-mers in the shared table; not thread-safe
+{
+	int i, bits0 = h->h[0].c->bits, bits = bits0;
+	double m = (double)n / (1U<<h->pre);
+	uint64_t max = 0, *t;
+	for (i = 0; i < 1<<h->pre; ++i)
+		max = max > h->h[i].c->count? max : h->h[i].c->count;
+	max += (uint64_t)(m + 4.0 * sqrt(m) + 16.0); // segments don't get exactly the same number of k-mers
+	while ((uint64_t)((1ULL<<bits) * YAK_CT_LOAD) < max) ++bits;
+	if (bits == bits0) return;
+	// Enlarge the block in place; for large blocks, realloc() remaps pages without copying. The new
+	// area of segment i only overlaps the old areas of segments i and above, so we go downwards.
+	h->ct = (uint64_t*)yak_realloc(h->ct, ((size_t)1<<(h->pre + bits)) * sizeof(uint64_t));
+	MALLOC(t, 1ULL<<bits0);
+	for (i = (1<<h->pre) - 1; i >= 0; --i) {
+		yak_ct_t *c = h->h[i].c;
+		uint64_t *a = &h->ct[(size_t)i << bits];
+		memcpy(t, &h->ct[(size_t)i << bits0], (1ULL<<bits0) * sizeof(uint64_t));
+		memset(a, 0, (1ULL<<bits) * sizeof(uint64_t));
+		c->a = t;
+		yak_ct_rehash(c, a, bits);
+	}
+	free(t);
+}
+
+void yak_ch_reserve(yak_ch_t *h, uint64_t n, int n_thread) // make room for $n distinct k-mers in total; sub-tables won't grow unless $n is underestimated by >1%
+{
+	reserve_aux_t a;
+	double m = (double)n / (1U<<h->pre);
+	if (h->flag & YAK_F_SHARED) {
+		yak_ch_grow(h, n);
+		return;
+	}
+	a.h = h;
+	a.n = (uint64_t)(m * 1.01 + 4.0 * sqrt(m) + 16.0); // HyperLogLog is accurate to ~0.4%; as in yak_ch_grow(), leave room for sub-tables getting more than their share
+	kt_for(n_thread, worker_reserve, &a, 1<<h->pre);
+}
+
+/*** Clear all counts to 0 ***/
+
+static void worker_clear(void *data, long i, int tid) // callback for kt_for()
+{
+	yak_ch_t *h = (yak_ch_t*)data;
+	yak_ch1_t *g = &h->h[i];
+	if (g->q) {
+		uint64_t j;
+		for (j = 0; g->q->s && j < 1ULL<<g->q->bits; ++j) {
+			uint64_t v = yak_qt_slot(g->q, j);
+			if (yak_qt_dist(g->q, v))
+				yak_qt_set(g->q, j, v & ~(uint64_t)YAK_MAX_COUNT);
+		}
+	} else {
+		khint_t k;
+		yak_kw_t mask = ~(yak_kw_t)YAK_MAX_COUNT;
+		for (k = 0; k < kh_end(g->h); ++k)
+			if (kh_exist(g->h, k))
+				kh_key(g->h, k) &= mask;
+	}
+	yak_ov_destroy(g->ov);
+	g->ov = 0;
+}
+
+void yak_ch_clear(yak_ch_t *h, int n_thread)
+{
+	assert(!(h->flag & YAK_F_SHARED)); // a zero counter would mark an empty slot in the shared table
+	kt_for(n_thread, worker_clear, h, 1<<h->pre);
+}
+
+/*** generate histogram ***/
+
+typedef struct {
+	const yak_ch_t *h;
+	int n_cnt, n_col; // n_col is 3 with YAK_F_STRANDED: total, forward and reverse counts
+	uint64_t *cnt; // n_thread*n_col*n_cnt
+} hist_aux_t;
+
+static inline void hist_add(const hist_aux_t *a, const yak_ch1_t *g, uint64_t *cnt, yak_kw_t x, int c) // add k-mer $x with counter bits $c
+{
+	int64_t f, r;
+	if (!(a->h->flag & YAK_F_STRANDED)) {
+		f = c == YAK_MAX_COUNT? yak_ch1_count(g, x, c) : c;
+		++cnt[f < a->n_cnt? f : a->n_cnt - 1];
+		return;
+	}
+	f = yak_ch1_count_s(g, x, c, 0), r = yak_ch1_count_s(g, x, c, 1);
+	++cnt[f + r < a->n_cnt? f + r : a->n_cnt - 1];
+	++cnt[a->n_cnt + (f < a->n_cnt? f : a->n_cnt - 1)];
+	++cnt[a->n_cnt * 2 + (r < a->n_cnt? r : a->n_cnt - 1)];
+}
+
+static void worker_hist(void *data, long i, int tid) // callback for kt_for()
+{
+	hist_aux_t *a = (hist_aux_t*)data;
+	uint64_t *cnt = &a->cnt[(size_t)tid * a->n_col * a->n_cnt];
+	const yak_ch1_t *g = &a->h->h[i];
+	if (g->k) {
+		uint64_t j;
+		for (j = 0; j < (uint64_t)YAK_CK_SLOTS << g->k->bits; ++j) {
+			uint64_t v = g->k->a[j];
+			if (v) hist_add(a, g, cnt, v >> YAK_COUNTER_BITS, v & YAK_MAX_COUNT);
+		}
+	} else if (g->c) {
+		uint64_t j;
+		for (j = 0; j < 1ULL<<g->c->bits; ++j) {
+			uint64_t v = g->c->a[j];
+			if (v) hist_add(a, g, cnt, v >> YAK_COUNTER_BITS, v & YAK_MAX_COUNT);
+		}
+	} else if (g->q) {
+		uint64_t j;
+		for (j = 0; g->q->s && j < 1ULL<<g->q->bits; ++j) {
+			uint64_t v = yak_qt_slot(g->q, j);
+			if (yak_qt_dist(g->q, v)) hist_add(a, g, cnt, yak_qt_key(g->q, j, v), v & YAK_MAX_COUNT);
+		}
+	} else {
+		khint_t k;
+		for (k = 0; k < kh_end(g->h); ++k)
+			if (kh_exist(g->h, k))
+				hist_add(a, g, cnt, kh_key(g->h, k) >> YAK_COUNTER_BITS, kh_key(g->h, k) & YAK_MAX_COUNT);
+	}
+}
+
+void yak_ch_hist(const yak_ch_t *h, int n_cnt, int64_t *cnt, int n_thread) // counts >= n_cnt-1 go to cnt[n_cnt-1]; with YAK_F_STRANDED, forward and reverse counts follow in cnt[n_cnt..3*n_cnt)
+{
+	hist_aux_t a;
+	int i, j;
+	a.h = h, a.n_cnt = n_cnt, a.n_col = h->flag & YAK_F_STRANDED? 3 : 1;
+	CALLOC(a.cnt, (size_t)n_thread * a.n_col * n_cnt);
+	kt_for(n_thread, worker_hist, &a, 1<<h->pre);
+	for (i = 0; i < a.n_col * n_cnt; ++i) cnt[i] = 0;
+	for (j = 0; j < n_thread; ++j)
+		for (i = 0; i < a.n_col * n_cnt; ++i)
+			cnt[i] += a.cnt[(size_t)j * a.n_col * n_cnt + i];
+	free(a.cnt);
+}
+
+/*** shrink a hash table ***/
+
+typedef struct {
+	int64_t min, max;
+	yak_ch_t *h;
+} shrink_aux_t;
+
+static inline void yak_ov_copy1(yak_ov_t **dst, const yak_ch1_t *g, yak_kw_t x) // copy the overflow entry of $x, if present
+{
+	int absent;
+	khint_t k, l;
+	if (g->ov == 0 || (k = yak_ov_get(g->ov, x)) == kh_end(g->ov)) return;
+	if (*dst == 0) *dst = yak_ov_init();
+	l = yak_ov_put(*dst, x, &absent);
+	kh_val(*dst, l) = kh_val(g->ov, k);
+}
+
+static inline void yak_ov_copy(yak_ov_t **dst, const yak_ch_t *h, const yak_ch1_t *g, yak_kw_t x, int c) // keep the exact count of $x with counter bits $c
+{
+	if (h->flag & YAK_F_STRANDED) {
+		if ((c & YAK_SC_MAX) == YAK_SC_MAX) yak_ov_copy1(dst, g, x << 1);
+		if ((c >> YAK_SC_BITS & YAK_SC_MAX) == YAK_SC_MAX) yak_ov_copy1(dst, g, x << 1 | 1);
+	} else if (c == YAK_MAX_COUNT) yak_ov_copy1(dst, g, x);
+}
+
+static void worker_shrink(void *data, long i, int tid) // callback for kt_for()
+{
+	shrink_aux_t *a = (shrink_aux_t*)data;
+	yak_ch_t *h = a->h;
+	yak_ch1_t *g = &h->h[i];
+	yak_ov_t *ov = 0;
+	int64_t c;
+	if (g->c) { // keep the slots of the segment
+		uint64_t j, n = 0, *b;
+		MALLOC(b, g->c->count + 1);
+		for (j = 0; j < 1ULL<<g->c->bits; ++j) {
+			uint64_t x, v = g->c->a[j];
+			if (v == 0) continue;
+			x = v >> YAK_COUNTER_BITS;
+			c = yak_ch_count(h, g, x, v & YAK_MAX_COUNT);
+			if (c >= a->min && c <= a->max) {
+				b[n++] = v;
+				yak_ov_copy(&ov, h, g, x, v & YAK_MAX_COUNT);
+			}
+		}
+		memset(g->c->a, 0, (1ULL<<g->c->bits) * sizeof(uint64_t));
+		g->c->count = n;
+		for (j = 0; j < n; ++j) {
+			uint64_t k, mask = (1ULL<<g->c->bits) - 1;
+			for (k = b[j] >> YAK_COUNTER_BITS & mask; g->c->a[k]; k = (k + 1) & mask) {}
+			g->c->a[k] = b[j];
+		}
+		free(b);
+	} else if (g->q) {
+		yak_qt_t *f;
+		uint64_t j;
+		f = yak_qt_init(g->q->kb);
+		yak_qt_reserve(f, g->q->count);
+		for (j = 0; g->q->s && j < 1ULL<<g->q->bits; ++j) {
+			uint64_t x, v = yak_qt_slot(g->q, j);
+			int64_t k;
+			int absent;
+			if (yak_qt_dist(g->q, v) == 0) continue;
+			x = yak_qt_key(g->q, j, v);
+			c = yak_ch_count(h, g, x, v & YAK_MAX_COUNT);
+			if (c >= a->min && c <= a->max) {
+				k = yak_qt_put(f, x, &absent);
+				yak_qt_set(f, k, yak_qt_slot(f, k) | (v & YAK_MAX_COUNT));
+				yak_ov_copy(&ov, h, g, x, v & YAK_MAX_COUNT);
+			}
+		}
+		yak_qt_destroy(g->q);
+		g->q = f;
+	} else {
+		yak_ht_t *f;
+		khint_t k;
+		f = yak_ht_init();
+		yak_ht_resize(f, kh_size(g->h));
+		for (k = 0; k < kh_end(g->h); ++k) {
+			int absent;
+			yak_kw_t x;
+			if (!kh_exist(g->h, k)) continue;
+			x = kh_key(g->h, k) >> YAK_COUNTER_BITS;
+			c = yak_ch_count(h, g, x, kh_key(g->h, k) & YAK_MAX_COUNT);
+			if (c >= a->min && c <= a->max) {
+				yak_ht_put(f, kh_key(g->h, k), &absent);
+				yak_ov_copy(&ov, h, g, x, kh_key(g->h, k) & YAK_MAX_COUNT);
+			}
+		}
+		yak_ht_destroy(g->h);
+		g->h = f;
+	}
+	yak_ov_destroy(g->ov);
+	g->ov = ov;
+}
+
+void yak_ch_shrink(yak_ch_t *h, int64_t min, int64_t max, int n_thread)
+{
+	int i;
+	shrink_aux_t a;
+	a.h = h, a.min = min, a.max = max;
+	kt_for(n_thread, worker_shrink, &a, 1<<h->pre);
+	for (i = 0, h->tot = 0; i < 1<<h->pre; ++i)
+		h->tot += yak_ch1_size(&h->h[i]);
+}
+
+/*** convert to bucketized cuckoo hash tables ***/
+
+static void worker_cuckoo(void *data, long i, int tid) // callback for kt_for()
+{
+	yak_ch_t *h = (yak_ch_t*)data;
+	yak_ch1_t *g = &h->h[i];
+	uint64_t j, n = 0, *a;
+	MALLOC(a, yak_ch1_size(g) + 1);
+	if (g->c) {
+		for (j = 0; j < 1ULL<<g->c->bits; ++j)
+			if (g->c->a[j]) a[n++] = g->c->a[j];
+	} else if (g->q) {
+		for (j = 0; g->q->s && j < 1ULL<<g->q->bits; ++j) {
+			uint64_t v = yak_qt_slot(g->q, j);
+			if (yak_qt_dist(g->q, v))
+				a[n++] = yak_qt_key(g->q, j, v) << YAK_COUNTER_BITS | (v & YAK_MAX_COUNT);
+		}
+		yak_qt_destroy(g->q);
+		g->q = 0;
+	} else {
+		khint_t k;
+		for (k = 0; k < kh_end(g->h); ++k)
+			if (kh_exist(g->h, k)) a[n++] = kh_key(g->h, k);
+		yak_ht_destroy(g->h);
+		g->h = 0;
+	}
+	g->k = yak_ck_build(n, a, &h->ck[h->ck_off[i]]);
+	free(a);
+}
+
+void yak_ch_cuckoo(yak_ch_t *h, int n_thread) // convert all sub-tables for faster lookups; no more insertions afterwards
+{
+	int i;
+	size_t z = 0;
+	if (YAK_KW_BITS > 64 || h->h[0].k) return; // cuckoo tables keep 64-bit words
+	MALLOC(h->ck_off, 1<<h->pre);
+	for (i = 0; i < 1<<h->pre; ++i) { // like the shared table, one block for all to cut TLB misses with huge pages
+		h->ck_off[i] = z;
+		z += (size_t)YAK_CK_SLOTS << yak_ck_bits(yak_ch1_size(&h->h[i]));
+	}
+	h->ck = (uint64_t*)yak_malloc(z * sizeof(uint64_t)); // sub-table sizes are multiples of 64 bytes, so all buckets stay aligned
+	kt_for(n_thread, worker_cuckoo, h, 1<<h->pre);
+	for (i = 0; i < 1<<h->pre; ++i) { // the shared table owns the memory of its segments
+		free(h->h[i].c);
+		h->h[i].c = 0;
+	}
+	free(h->ct);
+	h->ct = 0;
+}
+
+/*** batch lookups ***/
+
+#define YAK_GET_BLK 4096
+
+typedef struct {
+	const yak_ch_t *h;
+	int64_t n;
+	const yak_kw_t *a;
+	int64_t *c;
+} get_aux_t;
+
+static void worker_get(void *data, long i, int tid) // callback for kt_for()
+{
+	get_aux_t *a = (get_aux_t*)data;
+	const yak_ch_t *h = a->h;
+	int64_t j, st = i * YAK_GET_BLK, en = st + YAK_GET_BLK < a->n? st + YAK_GET_BLK : a->n;
+	int mask = (1<<h->pre) - 1;
+	for (j = st; j < en; ++j) {
+		if (j + YAK_PF_DIST < en) { // fetch the buckets of a later k-mer
+			yak_kw_t y = a->a[j + YAK_PF_DIST];
+			const yak_ch1_t *g = &h->h[y & mask];
+			if (g->k) yak_ck_prefetch(g->k, y >> h->pre);
+			else yak_ch_prefetch(h, g, 0, y);
+		}
+		a->c[j] = yak_ch_get(h, a->a[j]);
+	}
+}
+
+int yak_ch_get_list(const yak_ch_t *h, int64_t n, const yak_kw_t *a, int64_t *c, int n_thread) // c[i] = yak_ch_get(h, a[i]); -1 on YAK_F_MINIMIZER tables
+{
+	get_aux_t aux;
+	if (h->flag & YAK_F_MINIMIZER) return -1;
+	aux.h = h, aux.n = n, aux.a = a, aux.c = c;
+	kt_for(n_thread, worker_get, &aux, (n + YAK_GET_BLK - 1) / YAK_GET_BLK);
+	return 0;
+}
+
+/****************
+ * From count.c *
+ ****************/
+
+#include <string.h>
+#include "kgz.h" // gzip reader that decompresses ahead on another thread; BGZF blocks are inflated in parallel
+#include "kseq.h" // FASTA/Q parser
+#include "knt4.h" // SIMD nucleotide encoder
+KSEQ_INIT(kgz_t*, kgz_read)
+
+void yak_copt_init(yak_copt_t *o)
+{
+	memset(o, 0, sizeof(yak_copt_t));
+	o->flag = YAK_COUNTER_BITS < 8? YAK_F_SATURATE : 0; // exact counts would mostly live in the overflow tables
+	o->bf_shift = 0;
+	o->bf_n_hash = 4;
+	o->n_k = 1, o->k[0] = 31;
+	o->pre = yak_min_pre(o->k[0]) > 10? yak_min_pre(o->k[0]) : 10;
+	o->n_thread = 4;
+	o->chunk_size = 10000000;
+}
+
+typedef struct {
+	int n, m;
+	uint64_t n_ins;
+	yak_kw_t *a;
+} ch_buf_t;
+
+static inline void ch_insert_buf(ch_buf_t *buf, int p, yak_kw_t y) // insert a k-mer $y to a linear buffer
+{
+	int pre = (int)y & ((1<<p) - 1);
+	ch_buf_t *b = &buf[pre];
+	if (b->n == b->m) {
+		b->m = b->m < 8? 8 : b->m + (b->m>>1);
+		REALLOC(b->a, b->m);
+	}
+	b->a[b->n++] = y;
+}
+
+static inline yak_kw_t yak_kmer_hash(const yak_kw_t x[2], int strand, yak_kw_t mask) // hash the forward or the canonical k-mer; see yak_copt_t::strand
+{
+	if (strand == 0) return yak_hash(x[0] < x[1]? x[0] : x[1], mask);
+	if (strand == 1) return yak_hash(x[0], mask);
+	return x[0] <= x[1]? yak_hash(x[0], mask) : yak_hash(x[1], mask) | (mask + 1); // set bit 2k for the reverse strand
+}
+
+static inline int yak_hpc32(uint64_t *w, uint32_t *amb, int n, int *last) // collapse homopolymers in $n encoded bases in place; return the new length
+{
+	uint64_t x = *w, y = 0;
+	uint32_t a = *amb, b = 0;
+	int j, m = 0, l = *last; // l: the previous base, or -1 after an "N"
+	for (j = 0; j < n; ++j, x >>= 2, a >>= 1) { // branch-free; skipped bases write zeros to be overwritten by the next kept one
+		int c = x & 3, keep = (a & 1) || c != l;
+		y |= (uint64_t)(keep? c : 0) << m * 2;
+		b |= (a & 1) << m;
+		l = a & 1? -1 : c;
+		m += keep;
+	}
+	*w = y, *amb = b, *last = l;
+	return m;
+}
+
+static void count_seq_buf(ch_buf_t *buf, int n_k, const int32_t *ks, int p, int strand, int hpc, int len, const char *seq) // insert k-mers in $seq to linear buffers; the t-th k-mer size uses buf[t<<p...]
+{
+	int i, j, t, l[YAK_MAX_NK], last = -1;
+	yak_kw_t st[YAK_MAX_NK][2];
+	memset(l, 0, n_k * sizeof(int));
+	memset(st, 0, n_k * sizeof(st[0]));
+	for (i = 0; i < len; i += 32) {
+		uint32_t amb0;
+		uint64_t w0 = knt4_enc32(&seq[i], len - i, &amb0); // 32 bases in 2-bit codes; encoded once for all k
+		int n = len - i < 32? len - i : 32;
+		if (hpc) n = yak_hpc32(&w0, &amb0, n, &last); // a run is collapsed as a stream, across blocks
+		for (t = 0; t < n_k; ++t) {
+			int k = ks[t], shift = (k - 1) * 2, lt = l[t];
+			uint32_t amb = amb0;
+			uint64_t w = w0;
+			ch_buf_t *b = &buf[t << p];
+			yak_kw_t x[2], mask = k * 2 < YAK_KW_BITS? ((yak_kw_t)1<<k*2) - 1 : ~(yak_kw_t)0;
+			x[0] = st[t][0], x[1] = st[t][1]; // local copies; stores to $b may alias $st
+			if (amb == 0 && lt >= k - 1) { // no "N" in this block and the first k-mer is complete
+				for (j = 0; j < n; ++j, w >>= 2) {
+					yak_kw_t c = w & 3;
+					x[0] = (x[0] << 2 | c) & mask;
+					x[1] = x[1] >> 2 | (3 - c) << shift;
+					ch_insert_buf(b, p, yak_kmer_hash(x, strand, mask));
+				}
+				lt += n;
+			} else {
+				for (j = 0; j < n; ++j, w >>= 2, amb >>= 1) {
+					int c = w & 3;
+					if (!(amb & 1)) { // not an "N" base
+						x[0] = (x[0] << 2 | c) & mask;                  // forward strand
+						x[1] = x[1] >> 2 | (yak_kw_t)(3 - c) << shift;  // reverse strand
+						if (++lt >= k) // we find a k-mer
+							ch_insert_buf(b, p, yak_kmer_hash(x, strand, mask));
+					} else lt = 0, x[0] = x[1] = 0; // if there is an "N", restart
+				}
+			}
+			st[t][0] = x[0], st[t][1] = x[1], l[t] = lt;
+		}
+	}
+}
+
+/*
+ * Spaced seeds (-g). Base i of a window of $span bases is used if the i-th
+ * character of the pattern is "1". The pattern is applied to the forward
+ * window and, as a read from the other strand would see it, to the reverse
+ * complement of the window. Used bases are packed with PEXT if BMI2 is
+ * available, or with one shift and mask per run of used bases otherwise. The
+ * packed k-mer of weight k then goes through yak_hash() like a contiguous one.
+ */
+int yak_seed_init(yak_seed_t *g, const char *pat) // return the weight, or -1 for an invalid pattern
+{
+	int i, s, w = 0, span = strlen(pat);
+	memset(g, 0, sizeof(yak_seed_t));
+	if (span < 1 || span > 32 || pat[0] != '1' || pat[span-1] != '1') return -1;
+	for (i = 0; i < span; ++i) {
+		if (pat[i] != '0' && pat[i] != '1') return -1;
+		if (pat[i] == '1') g->m[0] |= 3ULL << 2 * (span - 1 - i), ++w; // base i is at bits 2*(span-1-i) of the forward window
+		if (pat[span-1-i] == '1') g->m[1] |= 3ULL << 2 * i; // the complement of base i is at bits 2*i of the reverse window; mirror the pattern there
+	}
+	for (s = 0; s < 2; ++s) {
+		int j, n = 0;
+		for (j = 0; j < 64;) {
+			int e;
+			if (!(g->m[s] >> j & 1)) { ++j; continue; }
+			for (e = j; e < 64 && (g->m[s] >> e & 1); ++e) {}
+			g->rs[s][g->n_run[s]] = j - n; // bits [j,e) go to [n,n+e-j)
+			g->rm[s][g->n_run[s]++] = (e - j < 64? (1ULL<<(e - j)) - 1 : ~0ULL) << j;
+			n += e - j, j = e;
+		}
+	}
+	g->span = span;
+	return w;
+}
+
+static inline uint64_t yak_seed_ext(const yak_seed_t *g, int s, uint64_t x) // branch-free except the loop, which is the same for every window
+{
+	int r;
+	uint64_t y = 0;
+	for (r = 0; r < g->n_run[s]; ++r)
+		y |= (x & g->rm[s][r]) >> g->rs[s][r];
+	return y;
+}
+
+#define YAK_SEED_FUNC(name, attr, ext) \
+	attr static void name(ch_buf_t *buf, const yak_seed_t *g, int k, int p, int strand, int len, const char *seq) { \
+		int i, j, l, shift = (g->span - 1) * 2; \
+		uint64_t x[2], mask = g->span < 32? (1ULL<<g->span*2) - 1 : ~0ULL; \
+		yak_kw_t kmask = k * 2 < YAK_KW_BITS? ((yak_kw_t)1<<k*2) - 1 : ~(yak_kw_t)0; \
+		for (i = l = 0, x[0] = x[1] = 0; i < len; i += 32) { \
+			uint32_t amb; \
+			uint64_t w = knt4_enc32(&seq[i], len - i, &amb); \
+			for (j = 0; j < 32 && i + j < len; ++j, w >>= 2, amb >>= 1) { \
+				uint64_t c = w & 3; \
+				if (!(amb & 1)) { \
+					x[0] = (x[0] << 2 | c) & mask; \
+					x[1] = x[1] >> 2 | (3 - c) << shift; \
+					if (++l >= g->span) { \
+						yak_kw_t y[2]; \
+						y[0] = ext(g, 0, x[0]), y[1] = ext(g, 1, x[1]); \
+						ch_insert_buf(buf, p, yak_kmer_hash(y, strand, kmask)); \
+					} \
+				} else l = 0, x[0] = x[1] = 0; \
+			} \
+		} \
+	}
+
+YAK_SEED_FUNC(count_seq_seed_gen, , yak_seed_ext)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define yak_seed_pext(g, s, x) _pext_u64((x), (g)->m[(s)])
+YAK_SEED_FUNC(count_seq_seed_pext, __attribute__((target("bmi2"))), yak_seed_pext)
+#endif
+
+static void count_seq_seed(ch_buf_t *buf, const yak_seed_t *g, int k, int p, int strand, int len, const char *seq) // insert spaced k-mers in $seq to linear buffer $buf
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("bmi2")) {
+		count_seq_seed_pext(buf, g, k, p, strand, len, seq);
+		return;
+	}
+#endif
+	count_seq_seed_gen(buf, g, k, p, strand, len, seq);
+}
+
+static inline int yak_ch_insert1(yak_ch_t *h, yak_kw_t y) // insert one hashed k-mer $y to the shared table
+{
+	int s = (h->flag & YAK_F_STRANDED) && (y >> h->k * 2 & 1);
+	return yak_ch1_inc(&h->h[(int)y & ((1<<h->pre) - 1)], 1, h->flag, yak_ch_key(h, y), s);
+}
+
+static int count_seq_shared(yak_ch_t *h, int strand, int len, const char *seq) // insert k-mers in $seq to the shared table; return the number of new k-mers
+{
+	int i, j, l, k = h->k, n = 0, n_ins = 0;
+	int shift = (k - 1) * 2;
+	yak_kw_t x[2], mask = k * 2 < YAK_KW_BITS? ((yak_kw_t)1<<k*2) - 1 : ~(yak_kw_t)0, a[YAK_CT_PF_DIST];
+	for (i = l = 0, x[0] = x[1] = 0; i < len; i += 32) {
+		uint32_t amb;
+		uint64_t w = knt4_enc32(&seq[i], len - i, &amb);
+		for (j = 0; j < 32 && i + j < len; ++j, w >>= 2, amb >>= 1) {
+			int c = w & 3;
+			if (!(amb & 1)) {
+				x[0] = (x[0] << 2 | c) & mask;
+				x[1] = x[1] >> 2 | (yak_kw_t)(3 - c) << shift;
+				if (++l >= k) { // the slot of a k-mer is fetched YAK_CT_PF_DIST k-mers before it is inserted
+					yak_kw_t y = yak_kmer_hash(x, strand, mask);
+					if (n >= YAK_CT_PF_DIST) n_ins += yak_ch_insert1(h, a[n & (YAK_CT_PF_DIST - 1)]);
+					yak_ch_prefetch(h, &h->h[(int)y & ((1<<h->pre) - 1)], 1, y);
+					a[n++ & (YAK_CT_PF_DIST - 1)] = y;
+				}
+			} else l = 0, x[0] = x[1] = 0;
+		}
+	}
+	for (i = n > YAK_CT_PF_DIST? n - YAK_CT_PF_DIST : 0; i < n; ++i)
+		n_ins += yak_ch_insert1(h, a[i & (YAK_CT_PF_DIST - 1)]);
+	return n_ins;
+}
+
+/*
+ * Super-k-mer partitioning (-M). Consecutive k-mers sharing the minimizer, the
+ * smallest hashed canonical m-mer, form a super-k-mer. It is written once in
+ * 2-bit form to the partition given by the lowest $pre bits of the minimizer
+ * hash, and expanded to k-mers just before they are inserted. Each partition
+ * has its own sub-table. As the partition says nothing about the k-mer hash,
+ * keys keep all 2k bits (YAK_F_MINIMIZER).
+ */
+#define YAK_SK_MAX_LEN 255 // the length of a super-k-mer is kept in one byte
+
+typedef struct {
+	int64_t n, m;
+	uint8_t *a; // super-k-mers, each as a length byte followed by 4 bases per byte
+	uint64_t n_ins;
+} sk_buf_t;
+
+static void sk_buf_push(sk_buf_t *b, const uint64_t *w, int st, int l) // append bases [st,st+l) of 2-bit encoded $w
+{
+	int j, nb = (l + 3) >> 2;
+	if (b->n + nb + 9 > b->m) { // 8 more bytes as 64-bit words are copied
+		b->m = b->n + nb + 9;
+		b->m += b->m >> 1;
+		REALLOC(b->a, b->m);
+	}
+	b->a[b->n++] = l;
+	for (j = 0; j < l; j += 32) { // assuming little-endian
+		int i = st + j, sh = (i & 31) << 1;
+		uint64_t x = sh? w[i>>5] >> sh | w[(i>>5) + 1] << (64 - sh) : w[i>>5];
+		memcpy(&b->a[b->n + (j>>2)], &x, 8);
+	}
+	b->n += nb;
+}
+
+static void count_seq_sk(sk_buf_t *buf, int k, int m, int p, int len, const char *seq, uint64_t *w) // cut $seq into super-k-mers; $w has room for len/32+2 words
+{
+	int i, j, l, st = 0, cur = -1, mp = 0, nw = (len + 31) >> 5, win = k - m + 1;
+	int shift = (m - 1) * 2;
+	uint32_t *amb = (uint32_t*)&w[nw + 1];
+	uint64_t x[2], mask = m < 32? (1ULL<<m*2) - 1 : ~0ULL, mv = ~0ULL, v[64]; // hashes of the last 64 m-mers; the minimizer is mv at mp
+	for (i = 0; i < nw; ++i)
+		w[i] = knt4_enc32(&seq[i<<5], len - (i<<5), &amb[i]);
+	w[nw] = 0;
+	for (i = l = 0, x[0] = x[1] = 0; i < len; ++i) {
+		uint64_t c = w[i>>5] >> ((i&31) << 1) & 3;
+		if (amb[i>>5] >> (i&31) & 1) { // if there is an "N", restart
+			if (cur >= 0) sk_buf_push(&buf[cur], w, st, i - st);
+			l = 0, x[0] = x[1] = 0, cur = -1, mv = ~0ULL;
+			continue;
+		}
+		x[0] = (x[0] << 2 | c) & mask;
+		x[1] = x[1] >> 2 | (3 - c) << shift;
+		if (++l < m) continue;
+		v[i&63] = yak_hash64(x[0] < x[1]? x[0] : x[1], mask);
+		if (v[i&63] <= mv) mv = v[i&63], mp = i;
+		else if (mp <= i - win) // the minimizer has left the k-mer; rescan
+			for (j = i - win + 1, mv = ~0ULL; j <= i; ++j)
+				if (v[j&63] <= mv) mv = v[j&63], mp = j;
+		if (l >= k && ((int)(mv & ((1<<p) - 1)) != cur || i - st >= YAK_SK_MAX_LEN)) {
+			if (cur >= 0) sk_buf_push(&buf[cur], w, st, i - st);
+			st = i - k + 1, cur = mv & ((1<<p) - 1);
+		}
+	}
+	if (cur >= 0) sk_buf_push(&buf[cur], w, st, len - st);
+}
+
+static void sk_expand(ch_buf_t *b, int k, int p, int q, int fwd, const sk_buf_t *s) // put (forward, if $fwd) k-mers in super-k-mers of partition $q to $b, as hash<<p|q
+{
+	int64_t i, n = 0;
+	yak_kw_t mask = k * 2 < YAK_KW_BITS? ((yak_kw_t)1<<k*2) - 1 : ~(yak_kw_t)0, *a = b->a;
+	int shift = (k - 1) * 2;
+	for (i = 0; i < s->n;) {
+		int j, l = s->a[i++];
+		yak_kw_t x[2] = {0, 0};
+		if (n + l > b->m) {
+			b->m = n + l;
+			b->m += b->m >> 1;
+			REALLOC(b->a, b->m);
+			a = b->a;
+		}
+		for (j = 0; j < l; j += 32) { // 32 bases at a time; sk_buf_push() leaves enough room to read past the end
+			int t, e = l - j < 32? l - j : 32;
+			uint64_t w;
+			memcpy(&w, &s->a[i + (j>>2)], 8); // assuming little-endian
+			for (t = 0; t < e; ++t, w >>= 2) {
+				yak_kw_t c = w & 3;
+				x[0] = (x[0] << 2 | c) & mask;
+				x[1] = x[1] >> 2 | (3 - c) << shift;
+				if (j + t >= k - 1)
+					a[n++] = fwd || x[0] < x[1]? x[0] : x[1];
+			}
+		}
+		i += (l + 3) >> 2;
+	}
+	yak_hash_n(a, n, mask); // k-mers are contiguous here, so hashing them with SIMD pays off
+	for (i = 0; i < n; ++i)
+		a[i] = a[i] << p | q;
+	b->n = n;
+}
+
+/*
+ * Uncompressed input is mapped to memory and parsed in place, like
+ * kseq_read() does on a stream. A record is then a view into the mapping:
+ * no allocation or copy per read. Sequence or quality lines of a multi-line
+ * record are joined in place; the private mapping makes this copy-on-write.
+ */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef struct {
+	int64_t l, i; // size of the mapping; the start of the next record
+	int sync; // 1 for FASTA and 2 for FASTQ with 4-line records, which can be split at record boundaries; 0 otherwise
+	char *s;
+} yak_mm_t;
+
+static int64_t yak_mm_nl(const yak_mm_t *m, int64_t i, int n) // the position of the $n-th newline from $i, or -1
+{
+	const char *q = m->s + i, *e = m->s + m->l;
+	for (; n > 0; --n, ++q)
+		if ((q = (const char*)memchr(q, '\n', e - q)) == 0) return -1;
+	return q - m->s - 1;
+}
+
+static int64_t yak_mm_fq4(const yak_mm_t *m, int64_t i) // the end of a 4-line FASTQ record at $i, or -1
+{
+	int64_t n1, n2, n3, n4;
+	if (i >= m->l || m->s[i] != '@') return -1;
+	if ((n1 = yak_mm_nl(m, i, 1)) < 0 || (n2 = yak_mm_nl(m, n1 + 1, 1)) < 0 || n2 + 1 >= m->l || m->s[n2 + 1] != '+') return -1;
+	if ((n3 = yak_mm_nl(m, n2 + 1, 1)) < 0) return -1;
+	if ((n4 = yak_mm_nl(m, n3 + 1, 1)) < 0) n4 = m->l; // the last line may have no newline
+	return n2 - n1 == n4 - n3? (n4 < m->l? n4 + 1 : m->l) : -1; // sequence and quality of the same length
+}
+
+yak_mm_t *yak_mm_open(const char *fn) // NULL unless $fn is a non-empty uncompressed regular file
+{
+	struct stat st;
+	yak_mm_t *m;
+	void *a;
+	int fd;
+	if (stat(fn, &st) < 0 || !S_ISREG(st.st_mode)) return 0; // don't open a pipe that kgz_open() reads next
+	if ((fd = open(fn, O_RDONLY)) < 0) return 0;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < 2) {
+		close(fd);
+		return 0;
+	}
+	a = mmap(0, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (a == MAP_FAILED) return 0;
+	if (((uint8_t*)a)[0] == 0x1f && ((uint8_t*)a)[1] == 0x8b) { // gzip'd
+		munmap(a, st.st_size);
+		return 0;
+	}
+	madvise(a, st.st_size, MADV_SEQUENTIAL);
+	CALLOC(m, 1);
+	m->s = (char*)a, m->l = st.st_size;
+	if (m->s[0] == '>') m->sync = 1;
+	else if (m->s[0] == '@') { // FASTQ with 4-line records if the first records are
+		int64_t i = 0;
+		int n;
+		for (n = 0; n < 1000 && i < m->l && (i = yak_mm_fq4(m, i)) >= 0; ++n) {}
+		if (i >= 0) m->sync = 2;
+	}
+	return m;
+}
+
+static void yak_mm_release(yak_mm_t *m, int64_t st, int64_t en) // drop pages entirely in [st,en) after they have been used
+{
+	int64_t z = sysconf(_SC_PAGESIZE);
+	st = (st + z - 1) / z * z, en = en / z * z; // pages at the ends may be shared with the neighboring chunks
+	if (st < en) madvise(m->s + st, en - st, MADV_DONTNEED);
+}
+
+void yak_mm_close(yak_mm_t *m)
+{
+	if (m == 0) return;
+	munmap(m->s, m->l);
+	free(m);
+}
+
+static char *yak_mm_lines(yak_mm_t *m, char *p, int64_t max, int is_seq, int64_t *len) // join lines from $p in place up to $max bytes, or a line starting with '>', '+' or '@' if $is_seq
+{
+	char *e = m->s + m->l, *d = p, *q;
+	int64_t l;
+	for (*len = 0; p < e && *len < max && !(is_seq && (*p == '>' || *p == '+' || *p == '@')); p = q < e? q + 1 : e) {
+		if ((q = (char*)memchr(p, '\n', e - p)) == 0) q = e;
+		l = q - p;
+		if (l > 0 && p[l-1] == '\r') --l;
+		if (d + *len != p) memmove(d + *len, p, l);
+		*len += l;
+	}
+	return p;
+}
+
+static int yak_mm_read(yak_mm_t *m, int64_t *i, int64_t en, char **seq, char **qual, int *len) // the record from $*i if it starts before $en; >=0 for its length, -1 at the end, -2 if truncated
+{
+	char *e = m->s + m->l, *p = m->s + *i;
+	int64_t ls, lq;
+	while (p < e && *p != '>' && *p != '@') ++p; // at the header of the next record unless before the first
+	if (p - m->s >= en || (p = (char*)memchr(p, '\n', e - p)) == 0) return -1;
+	*seq = ++p, *qual = 0;
+	p = yak_mm_lines(m, p, INT64_MAX, 1, &ls);
+	if (ls > INT32_MAX) return -2;
+	*len = ls;
+	if (p < e && *p == '+') { // FASTQ
+		if ((p = (char*)memchr(p, '\n', e - p)) == 0) return -2;
+		*qual = ++p;
+		p = yak_mm_lines(m, p, ls, 0, &lq); // a quality line may start with '@' or '+'
+		if (lq != ls) return -2;
+	}
+	*i = p - m->s;
+	return *len;
+}
+
+static int64_t yak_mm_sync(const yak_mm_t *m, int64_t i) // the first record at or after $i; $m->l if none
+{
+	const char *e = m->s + m->l, *p = m->s + i;
+	if (i > 0 && p[-1] != '\n') p = (p = (const char*)memchr(p, '\n', e - p)) == 0? e : p + 1;
+	for (; p < e; p = (p = (const char*)memchr(p, '\n', e - p)) == 0? e : p + 1) {
+		if (m->sync == 1 && *p == '>') break;
+		if (m->sync == 2 && yak_mm_fq4(m, p - m->s) >= 0) break; // a quality line may start with '@', but then the line after next is a sequence
+	}
+	return p - m->s;
+}
+
+#define YAK_N_ARENA 4 // sequence arenas kept for reuse; enough for the chunks in flight
+#define YAK_RD_QUEUE 4 // with several input files, chunks read ahead of kt_pipeline()
+
+#include <pthread.h>
+
+typedef struct { // a byte range of a mapped file, parsed by one thread
+	const yak_copt_t *opt;
+	yak_mm_t *mm;
+	int64_t st, en, i; // records starting in [st,en) are parsed; parsing stops at $i
+	int n, m, err; // err is 1 if a record is truncated and 2 if a record isn't 4-line FASTQ
+	int *len;
+	char **seq, **qual;
+	int64_t sum_len, nk[YAK_MAX_NK];
+} yak_mmr_t;
+
+typedef struct { // an input file
+	yak_mm_t *mm; // used in place of $ks for uncompressed files; sequences point into the mapping
+	kgz_t *fp;
+	kseq_t *ks;
+	yak_mmr_t *mmr; // one per thread if $mm is parsed in parallel
+} yak_in_t;
+
+typedef struct { // arrays and sequence memory of a finished chunk, reused by the next one
+	int m;
+	int *len;
+	char **seq, **qual;
+	int64_t a_m;
+	char *a;
+} yak_arena_t;
+
+typedef struct { // global data structure for kt_pipeline()
+	const yak_copt_t *opt;
+	int create_new;
+	int n_in, n_rd; // input files; reader threads, or 0 to read in kt_pipeline() with one file
+	yak_in_t *in;
+	pthread_t *rd_tid;
+	pthread_mutex_t rd_lock;
+	pthread_cond_t rd_cv;
+	int i_in, n_rd_on; // the next file for a reader; readers still running
+	int q_n, q_i; // chunks in $q; the first of them
+	void *q[YAK_RD_QUEUE]; // chunks from the readers to be taken by kt_pipeline()
+	yak_ch_t **h; // one per k-mer size
+	yak_hll_t **hll; // one per k-mer size and thread; if not NULL, k-mers go to HyperLogLog sketches instead of $h
+	yak_smp_t *smp; // one per k-mer size and prefix for the first YAK_SMP_PRE prefixes; used along with $hll
+	uint64_t n_kmer[YAK_MAX_NK];
+	uint64_t n_lowq; // bases masked by -q
+	volatile int ar_lock;
+	int n_ar;
+	yak_arena_t ar[YAK_N_ARENA]; // free list of arenas
+} pldat_t;
+
+typedef struct { // data structure for each step in kt_pipeline()
+	pldat_t *p;
+	int n, m, sum_len, nk[YAK_MAX_NK];
+	int *len;
+	char **seq;
+	char **qual; // with -q; NULL for a sequence without qualities
+	yak_mm_t *mm;
+	int64_t mm_st, mm_en; // the sequences are in [mm_st,mm_en) of $mm if not NULL
+	int64_t a_l, a_m;
+	char *a; // without a mapping, sequences and qualities are copied here back to back
+	int n_sl, *sl; // sequences are split into $n_sl slices for extraction; slice j is [sl[j],sl[j+1])
+	ch_buf_t *buf; // (1<<pre) buffers per k-mer size per slice
+	sk_buf_t *sk; // (1<<pre) partitions of super-k-mers per slice with -M
+	ch_buf_t *tb; // one per thread; k-mers expanded from a partition
+	uint64_t n_ins[YAK_MAX_NK];
+} stepdat_t;
+
+static inline void mask_lowq(stepdat_t *s, int i) // apply -q to sequence $i
+{
+	if (s->qual && s->qual[i]) {
+		int n = knt4_mask_lowq(s->seq[i], s->qual[i], s->len[i], s->p->opt->min_q);
+		__sync_fetch_and_add(&s->p->n_lowq, n);
+	}
+}
+
+static void worker_shared(void *data, long i, int tid) // callback for kt_for()
+{
+	stepdat_t *s = (stepdat_t*)data;
+	int t;
+	mask_lowq(s, i);
+	for (t = 0; t < s->p->opt->n_k; ++t) {
+		int n_ins = count_seq_shared(s->p->h[t], s->p->opt->strand, s->len[i], s->seq[i]);
+		__sync_fetch_and_add(&s->n_ins[t], n_ins);
+	}
+}
+
+static void worker_extract(void *data, long j, int tid) // callback for kt_for(); extract k-mers or super-k-mers from slice $j
+{
+	stepdat_t *s = (stepdat_t*)data;
+	const yak_copt_t *opt = s->p->opt;
+	int i, t, n = 1<<opt->pre, st = s->sl[j], en = s->sl[j+1];
+	int strand = s->p->hll && opt->strand == 2? 0 : opt->strand; // estimates are for canonical k-mers without the strand bit
+	if (s->sk) {
+		sk_buf_t *sk = &s->sk[j * n];
+		int64_t sum_len = 0;
+		int max_len = 0;
+		uint64_t *w;
+		for (i = st; i < en; ++i) {
+			sum_len += s->len[i];
+			max_len = max_len > s->len[i]? max_len : s->len[i];
+		}
+		for (i = 0; i < n; ++i) {
+			sk[i].m = sum_len / 2 / n + 16; // bases are mostly covered by one or two super-k-mers
+			MALLOC(sk[i].a, sk[i].m);
+		}
+		MALLOC(w, (max_len >> 5) * 2 + 3); // 2-bit bases followed by ambiguity masks
+		for (i = st; i < en; ++i) {
+			mask_lowq(s, i);
+			count_seq_sk(sk, opt->k[0], opt->mz, opt->pre, s->len[i], s->seq[i], w);
+		}
+		free(w);
+	} else {
+		ch_buf_t *buf = &s->buf[j * opt->n_k * n];
+		for (t = 0; t < opt->n_k; ++t) {
+			int64_t nk = 0;
+			int m;
+			for (i = st; i < en; ++i)
+				if (s->len[i] >= opt->k[t]) nk += s->len[i] - opt->k[t] + 1;
+			m = (int)(nk * 1.2 / n) + 1;
+			for (i = 0; i < n; ++i) {
+				buf[t * n + i].m = m;
+				MALLOC(buf[t * n + i].a, m);
+			}
+		}
+		for (i = st; i < en; ++i) {
+			mask_lowq(s, i);
+			if (opt->seed.span > 0) count_seq_seed(buf, &opt->seed, opt->k[0], opt->pre, strand, s->len[i], s->seq[i]);
+			else count_seq_buf(buf, opt->n_k, opt->k, opt->pre, strand, opt->hpc, s->len[i], s->seq[i]);
+		}
+	}
+}
+
+static void worker_sk(void *data, long i, int tid) // callback for kt_for()
+{
+	stepdat_t *s = (stepdat_t*)data;
+	ch_buf_t *b = &s->tb[tid];
+	int j;
+	for (j = 0; j < s->n_sl; ++j) { // the n_ins of partition $i is kept in the first slice
+		sk_expand(b, s->p->opt->k[0], s->p->opt->pre, i, s->p->opt->strand == 1, &s->sk[(j << s->p->opt->pre) + i]);
+		s->sk[i].n_ins += yak_ch_insert_list(s->p->h[0], s->p->create_new, b->n, b->a);
+	}
+}
+
+static void worker_for(void *data, long i, int tid) // callback for kt_for()
+{
+	stepdat_t *s = (stepdat_t*)data;
+	const yak_copt_t *opt = s->p->opt;
+	int j, t = i >> opt->pre, ip = i & ((1<<opt->pre) - 1); // k-mer size and prefix
+	for (j = 0; j < s->n_sl; ++j) { // insert from each slice in turn; the n_ins of buffer $i is kept in the first slice
+		ch_buf_t *b = &s->buf[(j * opt->n_k << opt->pre) + i];
+		if (s->p->hll) {
+			int l, n_bits = opt->k[t] * 2 < 64? opt->k[t] * 2 : 64, pre = opt->pre;
+			for (l = 0; l < b->n; ++l) // with 128-bit k-mers, the lower 64 bits are enough for estimates
+				yak_hll_add(s->p->hll[t * opt->n_thread + tid], (uint64_t)b->a[l], n_bits);
+			if (ip < YAK_SMP_PRE) // a prefix is handled by one thread at a time
+				for (l = 0; l < b->n; ++l)
+					yak_smp_add(&s->p->smp[t * YAK_SMP_PRE + ip], (uint64_t)(b->a[l] >> pre));
+		} else s->buf[i].n_ins += yak_ch_insert_list(s->p->h[t], s->p->create_new, b->n, b->a);
+	}
+}
+
+static void split_slices(stepdat_t *s, int n_thread) // split sequences into slices of similar total lengths
+{
+	int i, j;
+	int64_t acc = 0;
+	s->n_sl = s->n < n_thread? s->n : n_thread;
+	MALLOC(s->sl, s->n_sl + 1);
+	for (i = j = 0; i < s->n && j < s->n_sl; ++i) {
+		if (acc >= (int64_t)s->sum_len * j / s->n_sl) s->sl[j++] = i;
+		acc += s->len[i];
+	}
+	s->n_sl = j; // fewer slices if a few sequences dominate
+	s->sl[j] = s->n;
+}
+
+static void arena_get(stepdat_t *s) // take arrays and sequence memory from the free list, if any
+{
+	pldat_t *p = s->p;
+	yak_arena_t *r;
+	while (__sync_lock_test_and_set(&p->ar_lock, 1)) {}
+	if (p->n_ar > 0) {
+		r = &p->ar[--p->n_ar];
+		s->m = r->m, s->len = r->len, s->seq = r->seq, s->qual = r->qual;
+		s->a_m = r->a_m, s->a = r->a;
+	}
+	__sync_lock_release(&p->ar_lock);
+}
+
+static void arena_put(stepdat_t *s) // return arrays and sequence memory to the free list, or free them if it is full
+{
+	pldat_t *p = s->p;
+	int full;
+	while (__sync_lock_test_and_set(&p->ar_lock, 1)) {}
+	if (!(full = (p->n_ar == YAK_N_ARENA))) {
+		yak_arena_t *r = &p->ar[p->n_ar++];
+		r->m = s->m, r->len = s->len, r->seq = s->seq, r->qual = s->qual;
+		r->a_m = s->a_m, r->a = s->a;
+	}
+	__sync_lock_release(&p->ar_lock);
+	if (full) {
+		free(s->len); free(s->seq); free(s->qual); free(s->a);
+	}
+}
+
+static void arena_free(pldat_t *p)
+{
+	int i;
+	for (i = 0; i < p->n_ar; ++i) {
+		yak_arena_t *r = &p->ar[i];
+		free(r->len); free(r->seq); free(r->qual); free(r->a);
+	}
+	p->n_ar = 0;
+}
+
+static void arena_push(stepdat_t *s, const char *seq, const char *qual, int l) // copy sequence $s->n and its qualities to the arena
+{
+	int64_t need = qual? 2 * l : l;
+	char *y;
+	if (s->a_l + need > s->a_m) { // move to a larger arena; the sequences so far point into the old one
+		int i;
+		int64_t m = s->a_l + need;
+		m += m >> 1;
+		MALLOC(y, m);
+		if (s->a_l) memcpy(y, s->a, s->a_l);
+		for (i = 0; i < s->n; ++i) {
+			s->seq[i] = y + (s->seq[i] - s->a);
+			if (s->qual && s->qual[i]) s->qual[i] = y + (s->qual[i] - s->a);
+		}
+		free(s->a);
+		s->a = y, s->a_m = m;
+	}
+	s->seq[s->n] = y = s->a + s->a_l;
+	memcpy(y, seq, l);
+	if (qual) {
+		s->qual[s->n] = y += l;
+		memcpy(y, qual, l);
+	}
+	s->a_l += need;
+}
+
+static void worker_parse(void *data, long j, int tid) // callback for kt_for(); parse byte range $j of a mapped file
+{
+	yak_mmr_t *r = &((yak_mmr_t*)data)[j];
+	const yak_copt_t *opt = r->opt;
+	int l, t, ret, min_k = opt->k[0];
+	char *seq, *qual;
+	for (t = 1; t < opt->n_k; ++t)
+		min_k = min_k < opt->k[t]? min_k : opt->k[t];
+	r->n = 0, r->sum_len = 0, r->i = r->st, r->err = 0;
+	memset(r->nk, 0, sizeof(r->nk));
+	for (;;) {
+		while (r->i < r->en && (r->mm->s[r->i] == '\n' || r->mm->s[r->i] == '\r')) ++r->i; // blank lines, skipped by yak_mm_read() too
+		if (r->mm->sync == 2 && r->i < r->en && yak_mm_fq4(r->mm, r->i) < 0) { // stop before yak_mm_read() joins wrapped lines in place
+			r->err = 2;
+			return;
+		}
+		if ((ret = yak_mm_read(r->mm, &r->i, r->en, &seq, &qual, &l)) < 0) break;
+		if (l < min_k) continue;
+		if (r->n == r->m) {
+			r->m = r->m < 16? 16 : r->m + (r->m>>1);
+			REALLOC(r->len, r->m);
+			REALLOC(r->seq, r->m);
+			REALLOC(r->qual, r->m);
+		}
+		r->seq[r->n] = seq, r->qual[r->n] = qual;
+		r->len[r->n++] = l;
+		r->sum_len += l;
+		for (t = 0; t < opt->n_k; ++t)
+			if (l >= opt->k[t]) r->nk[t] += l - opt->k[t] + 1;
+	}
+	r->err = (ret == -2);
+}
+
+static stepdat_t *read_chunk_mt(pldat_t *p, yak_in_t *r, stepdat_t *s) // read a block of sequences from a mapped file with all threads
+{
+	const yak_copt_t *opt = p->opt;
+	yak_mm_t *mm = r->mm;
+	int j, t, n = opt->n_thread;
+	if (r->mmr == 0) {
+		CALLOC(r->mmr, n);
+		for (j = 0; j < n; ++j)
+			r->mmr[j].opt = opt, r->mmr[j].mm = mm;
+	}
+	while (s->sum_len == 0 && mm->i < mm->l && mm->sync) { // a block may have no sequences long enough
+		int64_t st = mm->i, z = (int64_t)opt->chunk_size * mm->sync; // about half of FASTQ is qualities
+		int64_t en = z < mm->l - st? yak_mm_sync(mm, st + z) : mm->l;
+		for (j = 0; j < n; ++j) // split [st,en) at record boundaries
+			r->mmr[j].st = j == 0? st : yak_mm_sync(mm, st + (en - st) * j / n);
+		for (j = 0; j < n; ++j)
+			r->mmr[j].en = j < n - 1? r->mmr[j+1].st : en;
+		kt_for(n, worker_parse, r->mmr, n);
+		mm->i = en;
+		for (j = 0; j < n; ++j) {
+			yak_mmr_t *q = &r->mmr[j];
+			if (s->n + q->n > s->m) {
+				s->m = s->n + q->n;
+				REALLOC(s->len, s->m);
+				REALLOC(s->seq, s->m);
+				if (opt->min_q > 0) REALLOC(s->qual, s->m);
+			}
+			memcpy(&s->len[s->n], q->len, q->n * sizeof(int));
+			memcpy(&s->seq[s->n], q->seq, q->n * sizeof(char*));
+			if (opt->min_q > 0) memcpy(&s->qual[s->n], q->qual, q->n * sizeof(char*));
+			s->n += q->n, s->sum_len += q->sum_len;
+			for (t = 0; t < opt->n_k; ++t)
+				s->nk[t] += q->nk[t];
+			if (q->err == 1) { // stop at a truncated record as with one thread
+				mm->i = mm->l;
+				break;
+			} else if (q->err == 2 || q->i > q->en) { // the guess of 4-line FASTQ is wrong; records up to $q->i are complete and later ranges are dropped
+				fprintf(stderr, "[W::%s] FASTQ records are not all 4-line; parsing the rest of the file with one thread\n", __func__);
+				mm->i = q->i, mm->sync = 0;
+				break;
+			}
+		}
+	}
+	s->mm_en = mm->i;
+	if (s->sum_len > 0 || (!mm->sync && mm->i < mm->l)) return s; // an empty $s if the rest is left to read_chunk()
+	arena_put(s);
+	free(s);
+	return 0;
+}
+
+static stepdat_t *read_chunk(pldat_t *p, yak_in_t *r) // read a block of sequences from $r; NULL at the end of file
+{
+	const yak_copt_t *opt = p->opt;
+	int l, t, min_k = opt->k[0];
+	char *seq, *qual;
+	stepdat_t *s;
+	for (t = 1; t < opt->n_k; ++t)
+		min_k = min_k < opt->k[t]? min_k : opt->k[t];
+	CALLOC(s, 1);
+	s->p = p, s->mm = r->mm;
+	arena_get(s);
+	if (r->mm) s->mm_st = r->mm->i;
+	if (r->mm && r->mm->sync && opt->n_thread > 1 && p->n_rd == 0)
+		if ((s = read_chunk_mt(p, r, s)) == 0 || s->sum_len > 0) return s; // otherwise the block couldn't be split and is read below
+	for (;;) {
+		if (r->mm) {
+			if (yak_mm_read(r->mm, &r->mm->i, r->mm->l, &seq, &qual, &l) < 0) break;
+		} else {
+			if (kseq_read(r->ks) < 0) break;
+			l = r->ks->seq.l, seq = r->ks->seq.s;
+			qual = r->ks->qual.l == r->ks->seq.l? r->ks->qual.s : 0;
+		}
+		if (l < min_k) continue;
+		if (s->n == s->m) {
+			s->m = s->m < 16? 16 : s->m + (s->n>>1);
+			REALLOC(s->len, s->m);
+			REALLOC(s->seq, s->m);
+			if (opt->min_q > 0) REALLOC(s->qual, s->m);
+		}
+		if (opt->min_q > 0) s->qual[s->n] = qual;
+		if (r->mm) s->seq[s->n] = seq; // a view into the mapping
+		else arena_push(s, seq, opt->min_q > 0? qual : 0, l);
+		s->len[s->n++] = l;
+		s->sum_len += l;
+		for (t = 0; t < opt->n_k; ++t)
+			if (l >= opt->k[t]) s->nk[t] += l - opt->k[t] + 1;
+		if (s->sum_len >= opt->chunk_size)
+			break;
+	}
+	if (r->mm) s->mm_en = r->mm->i;
+	if (s->sum_len > 0) return s;
+	arena_put(s);
+	free(s);
+	return 0;
+}
+
+static void *yak_reader(void *data) // a reader thread; reads files in turn and queues their chunks
+{
+	pldat_t *p = (pldat_t*)data;
+	for (;;) {
+		stepdat_t *s;
+		int i;
+		pthread_mutex_lock(&p->rd_lock);
+		i = p->i_in++;
+		pthread_mutex_unlock(&p->rd_lock);
+		if (i >= p->n_in) break;
+		while ((s = read_chunk(p, &p->in[i])) != 0) {
+			pthread_mutex_lock(&p->rd_lock);
+			while (p->q_n == YAK_RD_QUEUE)
+				pthread_cond_wait(&p->rd_cv, &p->rd_lock);
+			p->q[(p->q_i + p->q_n++) % YAK_RD_QUEUE] = s;
+			pthread_cond_broadcast(&p->rd_cv);
+			pthread_mutex_unlock(&p->rd_lock);
+		}
+	}
+	pthread_mutex_lock(&p->rd_lock);
+	--p->n_rd_on;
+	pthread_cond_broadcast(&p->rd_cv);
+	pthread_mutex_unlock(&p->rd_lock);
+	return 0;
+}
+
+static char **yak_list_fn(const char *fn, int *n_) // $fn is a file, comma-separated files or @FILE listing one file per line
+{
+	char **a = 0, *p, *q, *str = 0;
+	int n = 0, m = 0;
+	*n_ = 0;
+	if (fn[0] == '@') { // file of file names
+		FILE *fp;
+		char buf[4096];
+		if ((fp = fopen(fn + 1, "r")) == 0) return 0;
+		while (fgets(buf, sizeof(buf), fp)) {
+			int l = strlen(buf);
+			while (l > 0 && (buf[l-1] == '\n' || buf[l-1] == '\r' || buf[l-1] == ' ' || buf[l-1] == '\t')) buf[--l] = 0;
+			if (l == 0 || buf[0] == '#') continue;
+			if (n == m) m = m? m<<1 : 16, REALLOC(a, m);
+			a[n++] = strdup(buf);
+		}
+		fclose(fp);
+	} else if (access(fn, F_OK) == 0 || strchr(fn, ',') == 0) { // a single file, possibly with a comma in its name
+		MALLOC(a, 1);
+		a[n++] = strdup(fn);
+	} else {
+		str = strdup(fn);
+		for (p = q = str;; ++p) {
+			if (*p == ',' || *p == 0) {
+				int c = *p;
+				*p = 0;
+				if (p > q) {
+					if (n == m) m = m? m<<1 : 16, REALLOC(a, m);
+					a[n++] = strdup(q);
+				}
+				if (c == 0) break;
+				q = p + 1;
+			}
+		}
+		free(str);
+	}
+	*n_ = n;
+	return a;
+}
+
+static int yak_in_open(pldat_t *p, const char *fn) // open input files; start reader threads with several of them
+{
+	int i, n_fn;
+	char **a;
+	if ((a = yak_list_fn(fn, &n_fn)) == 0 || n_fn == 0) {
+		free(a);
+		return -1;
+	}
+	CALLOC(p->in, n_fn);
+	for (i = 0; i < n_fn; ++i) {
+		yak_in_t *r = &p->in[i];
+		if ((r->mm = yak_mm_open(a[i])) == 0) { // fall back to the stream reader for compressed or special files
+			if ((r->fp = kgz_open(a[i], n_fn > 1? 1 : p->opt->n_thread)) == 0) { // readers decompress their own files
+				fprintf(stderr, "[E::%s] failed to open file '%s'\n", __func__, a[i]);
+				break;
+			}
+			r->ks = kseq_init(r->fp);
+		}
+		p->n_in = i + 1;
+	}
+	for (i = 0; i < n_fn; ++i) free(a[i]);
+	free(a);
+	if (p->n_in < n_fn) return -1;
+	if (n_fn > 1) {
+		p->n_rd = p->n_rd_on = n_fn < p->opt->n_thread? n_fn : p->opt->n_thread;
+		fprintf(stderr, "[M::%s] reading %d files with %d threads\n", __func__, n_fn, p->n_rd);
+		pthread_mutex_init(&p->rd_lock, 0);
+		pthread_cond_init(&p->rd_cv, 0);
+		MALLOC(p->rd_tid, p->n_rd);
+		for (i = 0; i < p->n_rd; ++i)
+			pthread_create(&p->rd_tid[i], 0, yak_reader, p);
+	}
+	return 0;
+}
+
+static void yak_in_close(pldat_t *p) // after kt_pipeline(); the readers have finished
+{
+	int i, j;
+	for (i = 0; i < p->n_rd; ++i)
+		pthread_join(p->rd_tid[i], 0);
+	if (p->n_rd > 0) {
+		pthread_mutex_destroy(&p->rd_lock);
+		pthread_cond_destroy(&p->rd_cv);
+		free(p->rd_tid);
+	}
+	for (i = 0; i < p->n_in; ++i) {
+		yak_in_t *r = &p->in[i];
+		if (r->mm) yak_mm_close(r->mm);
+		else kseq_destroy(r->ks), kgz_close(r->fp);
+		for (j = 0; r->mmr && j < p->opt->n_thread; ++j)
+			free(r->mmr[j].len), free(r->mmr[j].seq), free(r->mmr[j].qual);
+		free(r->mmr);
+	}
+	free(p->in);
+	arena_free(p);
+}
+
+static void *worker_pipeline(void *data, int step, void *in) // callback for kt_pipeline()
+{
+	pldat_t *p = (pldat_t*)data;
+	const yak_copt_t *opt = p->opt;
+	int t;
+	if (step == 0) { // step 1: read a block of sequences, or take one from the readers
+		stepdat_t *s = 0;
+		if (p->n_rd == 0) return read_chunk(p, &p->in[0]);
+		pthread_mutex_lock(&p->rd_lock);
+		while (p->q_n == 0 && p->n_rd_on > 0)
+			pthread_cond_wait(&p->rd_cv, &p->rd_lock);
+		if (p->q_n > 0) {
+			s = (stepdat_t*)p->q[p->q_i];
+			p->q_i = (p->q_i + 1) % YAK_RD_QUEUE, --p->q_n;
+			pthread_cond_broadcast(&p->rd_cv);
+		}
+		pthread_mutex_unlock(&p->rd_lock);
+		return s;
+	} else if (step == 1 && p->h && (p->h[0]->flag & YAK_F_SHARED)) { // step 2: extract and insert k-mers in parallel
+		stepdat_t *s = (stepdat_t*)in;
+		uint64_t tot = 0;
+		for (t = 0; t < opt->n_k; ++t)
+			yak_ch_grow(p->h[t], s->nk[t]); // no resizing when threads are inserting
+		kt_for(opt->n_thread, worker_shared, s, s->n);
+		if (s->mm) yak_mm_release(s->mm, s->mm_st, s->mm_en);
+		for (t = 0; t < opt->n_k; ++t) {
+			p->n_kmer[t] += s->nk[t];
+			p->h[t]->tot += s->n_ins[t];
+			tot += p->h[t]->tot;
+		}
+		fprintf(stderr, "[M] processed %d sequences; %ld distinct k-mers in the hash table\n", s->n, (long)tot);
+		arena_put(s);
+		free(s);
+	} else if (step == 1) { // step 2: extract k-mers, or cut reads into super-k-mers with -M, in parallel
+		stepdat_t *s = (stepdat_t*)in;
+		split_slices(s, opt->n_thread);
+		if (p->h && opt->mz > 0) CALLOC(s->sk, s->n_sl << opt->pre);
+		else CALLOC(s->buf, s->n_sl * opt->n_k << opt->pre);
+		kt_for(opt->n_thread, worker_extract, s, s->n_sl);
+		if (s->mm) yak_mm_release(s->mm, s->mm_st, s->mm_en);
+		arena_put(s);
+		free(s->sl);
+		return s;
+	} else if (step == 2 && ((stepdat_t*)in)->sk) { // step 3: expand super-k-mers and insert k-mers to hash table
+		stepdat_t *s = (stepdat_t*)in;
+		int i, n = 1<<opt->pre;
+		CALLOC(s->tb, opt->n_thread);
+		kt_for(opt->n_thread, worker_sk, s, n);
+		for (i = 0; i < n; ++i)
+			p->h[0]->tot += s->sk[i].n_ins;
+		for (i = 0; i < s->n_sl << opt->pre; ++i)
+			free(s->sk[i].a);
+		for (i = 0; i < opt->n_thread; ++i)
+			free(s->tb[i].a);
+		p->n_kmer[0] += s->nk[0];
+		fprintf(stderr, "[M] processed %d sequences; %ld distinct k-mers in the hash table\n", s->n, (long)p->h[0]->tot);
+		free(s->tb); free(s->sk); free(s);
+	} else if (step == 2) { // step 3: insert k-mers to hash table
+		stepdat_t *s = (stepdat_t*)in;
+		int i, n = 1<<opt->pre;
+		uint64_t tot = 0;
+		kt_for(opt->n_thread, worker_for, s, n * opt->n_k);
+		for (i = 0; i < s->n_sl * n * opt->n_k; ++i) {
+			t = i / n % opt->n_k;
+			if (p->h) p->h[t]->tot += s->buf[i].n_ins;
+			p->n_kmer[t] += s->buf[i].n;
+			free(s->buf[i].a);
+		}
+		free(s->buf);
+		if (p->h) {
+			for (t = 0; t < opt->n_k; ++t) tot += p->h[t]->tot;
+			fprintf(stderr, "[M] processed %d sequences; %ld distinct k-mers in the hash table\n", s->n, (long)tot);
+		}
+		free(s);
+	}
+	return 0;
+}
+
+yak_ch_t **yak_count(const char *fn, const yak_copt_t *opt, yak_ch_t **h0) // count k-mers of all sizes in $opt in one pass; add to $h0 if not NULL
+{
+	pldat_t pl;
+	int t;
+	memset(&pl, 0, sizeof(pldat_t));
+	pl.opt = opt;
+	if (yak_in_open(&pl, fn) < 0) {
+		yak_in_close(&pl);
+		return 0;
+	}
+	if (h0) {
+		pl.h = h0, pl.create_new = 0;
+		for (t = 0; t < opt->n_k; ++t)
+			assert(h0[t]->k == opt->k[t] && h0[t]->pre == opt->pre);
+	} else {
+		pl.create_new = 1;
+		CALLOC(pl.h, opt->n_k);
+		for (t = 0; t < opt->n_k; ++t) {
+			pl.h[t] = yak_ch_init(opt->k[t], opt->pre, opt->bf_n_hash, opt->bf_shift, opt->flag);
+			if (opt->n_est[t] > 0) yak_ch_reserve(pl.h[t], opt->n_est[t], opt->n_thread);
+		}
+		if (opt->n_est[0] > 0) {
+			uint64_t mem = 0;
+			for (t = 0; t < opt->n_k; ++t) mem += yak_ch_mem(pl.h[t]);
+			fprintf(stderr, "[M::%s] reserved %.3f GB for hash tables\n", __func__, mem / 1073741824.0);
+		}
+	}
+	if (opt->flag & YAK_F_SHARED) kt_pipeline(2, worker_pipeline, &pl, 2);
+	else kt_pipeline(3, worker_pipeline, &pl, 3);
+	if (opt->min_q > 0)
+		fprintf(stderr, "[M::%s] %ld bases with quality below %d treated as N\n", __func__, (long)pl.n_lowq, opt->min_q);
+	yak_in_close(&pl);
+	return pl.h;
+}
+
+typedef struct {
+	double f0, f1; // distinct k-mers; singletons
+	uint64_t n_kmer; // total k-mers
+} yak_est_t;
+
+int yak_count_est(const char *fn, const yak_copt_t *opt, yak_est_t *e) // estimate k-mer statistics of each size without counting
+{
+	pldat_t pl;
+	int i, t, n_smp = 1<<opt->pre < YAK_SMP_PRE? 1<<opt->pre : YAK_SMP_PRE;
+	memset(&pl, 0, sizeof(pldat_t));
+	pl.opt = opt;
+	if (yak_in_open(&pl, fn) < 0) {
+		yak_in_close(&pl);
+		return -1;
+	}
+	CALLOC(pl.hll, opt->n_k * opt->n_thread);
+	for (i = 0; i < opt->n_k * opt->n_thread; ++i)
+		pl.hll[i] = yak_hll_init(YAK_HLL_BITS);
+	CALLOC(pl.smp, opt->n_k * YAK_SMP_PRE);
+	kt_pipeline(3, worker_pipeline, &pl, 3);
+	for (t = 0; t < opt->n_k; ++t) {
+		yak_hll_t **hll = &pl.hll[t * opt->n_thread];
+		double f0 = 0.0, f1 = 0.0;
+		for (i = 1; i < opt->n_thread; ++i) {
+			yak_hll_merge(hll[0], hll[i]);
+			yak_hll_destroy(hll[i]);
+		}
+		e[t].f0 = yak_hll_est(hll[0]);
+		e[t].n_kmer = pl.n_kmer[t];
+		for (i = 0; i < n_smp; ++i) { // scale sampled counts up
+			yak_smp_t *smp = &pl.smp[t * YAK_SMP_PRE + i];
+			yak_sm_t *g = smp->h;
+			khint_t k;
+			for (k = 0; g && k < kh_end(g); ++k) {
+				if (!kh_exist(g, k)) continue;
+				f0 += (double)(1ULL<<smp->level);
+				if (kh_val(g, k) == 1) f1 += (double)(1ULL<<smp->level);
+			}
+			yak_sm_destroy(g);
+		}
+		e[t].f1 = f0 > 0.0? f1 / f0 * e[t].f0 : 0.0; // the singleton fraction is estimated from samples
+		yak_hll_destroy(hll[0]);
+	}
+	free(pl.hll); free(pl.smp);
+	yak_in_close(&pl);
+	return 0;
+}
+
+yak_ch_t **yak_count_file(const char *fn1, const char *fn2, const yak_copt_t *opt)
+{
+	yak_ch_t **h;
+	yak_copt_t o = *opt;
+	int t;
+	if ((opt->flag & YAK_F_PRESIZE) && opt->bf_shift == 0) { // with the bloom filter, most k-mers won't be inserted
+		yak_est_t e[YAK_MAX_NK];
+		if (yak_count_est(fn1, opt, e) < 0) return 0;
+		for (t = 0; t < opt->n_k; ++t) {
+			o.n_est[t] = (int64_t)e[t].f0;
+			fprintf(stderr, "[M::%s] ~%.0f distinct %d-mers estimated by HyperLogLog\n", __func__, (double)o.n_est[t], opt->k[t]);
+		}
+	}
+	opt = &o;
+	h = yak_count(fn1, opt, 0); // if bloom filter is in use, this gets approximate counts
+	if (h == 0) return 0;
+	if (opt->bf_shift > 0) { // bloom filter is in use
+		int i, n_tlb = 0;
+		for (t = 0; t < opt->n_k; ++t)
+			for (i = 0; i < 1<<opt->pre; ++i)
+				if (h[t]->h[i].b) n_tlb += h[t]->h[i].b->hugetlb;
+		fprintf(stderr, "[M::%s] %d/%d Bloom filters on hugetlbfs; %.3f GB on transparent huge pages\n", __func__,
+				n_tlb, opt->n_k<<opt->pre, yak_huge_mem() / 1073741824.0);
+		for (t = 0; t < opt->n_k; ++t) {
+			yak_ch_destroy_bf(h[t]); // deallocate bloom filter
+			yak_ch_clear(h[t], opt->n_thread); // set counts to 0
+		}
+		if (yak_count(fn2? fn2 : fn1, opt, h) == 0) { // count again
+			for (t = 0; t < opt->n_k; ++t)
+				yak_ch_destroy(h[t]);
+			free(h);
+			return 0;
+		}
+		for (t = 0; t < opt->n_k; ++t)
+			yak_ch_shrink(h[t], 2, INT64_MAX, opt->n_thread); // drop singleton k-mers caused by false positives in bloom filter
+	}
+	return h;
+}
+
+#include "ketopt.h"
+
+static int yak_print_est(const char *fn, const yak_copt_t *opt)
+{
+	yak_est_t e[YAK_MAX_NK];
+	int t;
+	if (yak_count_est(fn, opt, e) < 0) {
+		fprintf(stderr, "ERROR: failed to open file '%s'\n", fn);
+		return 1;
+	}
+	for (t = 0; t < opt->n_k; ++t) {
+		double n_ins = e[t].f0, mem, m;
+		int bf_shift = 0, pre = opt->pre;
+		if (e[t].f1 > 0.5 * e[t].f0) { // the Bloom filter pays off when most k-mers are singletons
+			while (bf_shift < 63 && (double)(1ULL<<bf_shift) < e[t].f0 * 16.0) ++bf_shift; // 16 bits per k-mer
+			n_ins = e[t].f0 - e[t].f1;
+		}
+		while (pre < 20 && n_ins / (1U<<pre) > (double)(1U<<23)) ++pre; // keep each table below 8 million k-mers
+		m = n_ins / (1U<<pre);
+		for (mem = 1.0; mem * 0.75 < m * 1.01 + 4.0 * sqrt(m) + 16.0; mem *= 2.0); // as in yak_ch_reserve()
+		mem *= (sizeof(yak_kw_t) + 0.125) * (1U<<pre);
+		if (opt->n_k > 1) printf("K\t%d\tk-mer size\n", opt->k[t]);
+		printf("F0\t%.0f\tdistinct k-mers\n", e[t].f0);
+		printf("f1\t%.0f\tsingletons\n", e[t].f1);
+		printf("f2+\t%.0f\tnon-singletons\n", e[t].f0 - e[t].f1);
+		printf("F1\t%llu\ttotal k-mers\n", (unsigned long long)e[t].n_kmer);
+		printf("RC\t-b%d -p%d\trecommended options; ~%.3f GB for hash tables\n", bf_shift, pre, mem / 1073741824.0);
+	}
+	return 0;
+}
+
+static int yak_parse_k(const char *s, int32_t *k) // parse a comma-separated list of k-mer sizes; return the count or -1
+{
+	int n = 0;
+	char *p;
+	for (;;) {
+		if (n == YAK_MAX_NK) return -1;
+		k[n++] = strtol(s, &p, 10);
+		if (p == s) return -1;
+		if (*p == 0) break;
+		if (*p != ',') return -1;
+		s = p + 1;
+	}
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	yak_ch_t **h;
+	char *seed = 0;
+	int i, t, c, max_k, max_cnt = YAK_MAX_COUNT, est_only = 0, to_cuckoo = 0, n_col, k_set = 0;
+	int64_t *cnt;
+	yak_copt_t opt;
 	ketopt_t o = KETOPT_INIT;
 	yak_copt_init(&opt);
-	while ((c = ketopt(&o, argc, argv, 1, "k:p:K:t:b:H:", 0)) >= 0) {
-		if (c == 'k') opt.k = atoi(o.arg);
+	knt4_init();
+	yak_hash_init();
+	while ((c = ketopt(&o, argc, argv, 1, "k:p:K:t:b:H:QSM:Csm:Pn:Eq:g:r:c", 0)) >= 0) {
+		if (c == 'k') opt.n_k = yak_parse_k(o.arg, opt.k), k_set = 1;
 		else if (c == 'p') opt.pre = atoi(o.arg);
 		else if (c == 'K') opt.chunk_size = atoi(o.arg);
 		else if (c == 't') opt.n_thread = atoi(o.arg);
 		else if (c == 'b') opt.bf_shift = atoi(o.arg);
 		else if (c == 'H') opt.bf_n_hash = atoi(o.arg);
+		else if (c == 'Q') opt.flag |= YAK_F_COMPACT;
+		else if (c == 'S') opt.flag |= YAK_F_SHARED;
+		else if (c == 'M') opt.mz = atoi(o.arg);
+		else if (c == 'C') to_cuckoo = 1;
+		else if (c == 's') opt.flag |= YAK_F_SATURATE;
+		else if (c == 'm') max_cnt = atoi(o.arg);
+		else if (c == 'P') opt.flag |= YAK_F_PRESIZE;
+		else if (c == 'n') opt.n_est[0] = (int64_t)atof(o.arg);
+		else if (c == 'E') est_only = 1;
+		else if (c == 'q') opt.min_q = atoi(o.arg);
+		else if (c == 'g') seed = o.arg;
+		else if (c == 'r') opt.strand = atoi(o.arg);
+		else if (c == 'c') opt.hpc = 1;
 	}
 	if (argc - o.ind < 1) {
 		fprintf(stderr, "Usage: yak-count [options] <in.fa> [in.fa]\n");
 		fprintf(stderr, "Options:\n");
-		fprintf(stderr, "  -k INT     k-mer size [%d]\n", opt.k);
+		fprintf(stderr, "  -k INT     k-mer size; up to %d comma-separated sizes are counted in one pass [%d]\n", YAK_MAX_NK, opt.k[0]);
 		fprintf(stderr, "  -p INT     prefix length [%d]\n", opt.pre);
 		fprintf(stderr, "  -b INT     set Bloom filter size to 2**INT bits; 0 to disable [%d]\n", opt.bf_shift);
 		fprintf(stderr, "  -H INT     use INT hash functions for Bloom filter [%d]\n", opt.bf_n_hash);
 		fprintf(stderr, "  -t INT     number of worker threads [%d]\n", opt.n_thread);
 		fprintf(stderr, "  -K INT     chunk size [100m]\n");
-		fprintf(stderr, "Note: -b37 is recommended for human reads\n");
+		fprintf(stderr, "  -q INT     treat bases with Phred quality below INT as N (FASTQ only) [%d]\n", opt.min_q);
+		fprintf(stderr, "  -Q         compact hash tables (less memory but slower)\n");
+		fprintf(stderr, "  -S         insert k-mers to one table shared by all threads (no Bloom filter or -Q)\n");
+		fprintf(stderr, "  -g STR     count spaced k-mers of seed STR, such as 1101101101; k is the number of 1s\n");
+		fprintf(stderr, "  -c         count homopolymer-compressed k-mers (for noisy long reads)\n");
+		fprintf(stderr, "  -r INT     0: canonical k-mers; 1: forward strand only; 2: forward and reverse counts per canonical k-mer (k<%d) [%d]\n", YAK_KW_BITS / 2, opt.strand);
+		fprintf(stderr, "  -M INT     partition reads into super-k-mers by INT-mer minimizers (k<=%d); 0 to disable [%d]\n", (YAK_KW_BITS - YAK_COUNTER_BITS) / 2, opt.mz);
+		fprintf(stderr, "  -C         convert to bucketized cuckoo hash tables for lookups after counting\n");
+		fprintf(stderr, "  -P         estimate distinct k-mers in a pre-pass and preallocate hash tables (reads <in.fa> once more);\n");
+		fprintf(stderr, "             tables don't grow unless the estimate is >1%% low or with -M\n");
+		fprintf(stderr, "  -n NUM     preallocate hash tables for NUM distinct k-mers [0]\n");
+		fprintf(stderr, "  -E         only estimate the numbers of distinct and singleton k-mers, and suggest -b/-p\n");
+		fprintf(stderr, "  -s         stop counting at %d%s\n", YAK_MAX_COUNT, YAK_COUNTER_BITS < 8? " (always on in this build)" : "");
+		fprintf(stderr, "  -m INT     max count in the histogram; larger counts are added to INT [%d]\n", max_cnt);
+		fprintf(stderr, "Note: -b37 is recommended for human reads; <in.fa> may be comma-separated files or @FILE listing\n");
+		fprintf(stderr, "      one file per line, and up to INT files from -t are decompressed and parsed in parallel\n");
 		return 1;
 	}
-	if (opt.pre < YAK_COUNTER_BITS) {
-		fprintf(stderr, "ERROR: -p should be at least %d\n", YAK_COUNTER_BITS);
+	if (seed) {
+		if (k_set || opt.mz > 0 || (opt.flag & YAK_F_SHARED)) {
+			fprintf(stderr, "ERROR: -g can't be used with -k, -S or -M; k is the number of 1s in the seed\n");
+			return 1;
+		}
+		if ((opt.k[0] = yak_seed_init(&opt.seed, seed)) < 0) {
+			fprintf(stderr, "ERROR: -g should be up to 32 0/1 characters starting and ending with 1\n");
+			return 1;
+		}
+	}
+	if (opt.n_k < 1) {
+		fprintf(stderr, "ERROR: -k should be up to %d comma-separated integers\n", YAK_MAX_NK);
+		return 1;
+	}
+	for (t = 0, max_k = 0; t < opt.n_k; ++t) {
+		if (opt.k[t] < 1 || opt.k[t] > YAK_MAX_KMER) {
+			fprintf(stderr, "ERROR: -k should be in [1,%d]\n", YAK_MAX_KMER);
+			return 1;
+		}
+		max_k = max_k > opt.k[t]? max_k : opt.k[t];
+		opt.n_est[t] = opt.n_est[0];
+	}
+	if (opt.pre < yak_min_pre(max_k) || opt.pre < 0) {
+		fprintf(stderr, "ERROR: -p should be at least %d for %d-bit counters\n", yak_min_pre(max_k) > 0? yak_min_pre(max_k) : 0, YAK_COUNTER_BITS);
+		return 1;
+	}
+	if (opt.mz > 0) {
+		if (opt.n_k > 1 || (opt.flag & YAK_F_SHARED) || opt.mz > opt.k[0] || opt.mz > 32) {
+			fprintf(stderr, "ERROR: -M takes one k-mer size, can't be used with -S and should be in [1,min(k,32)]\n");
+			return 1;
+		}
+		if (opt.k[0] * 2 + (opt.pre > YAK_COUNTER_BITS? opt.pre : YAK_COUNTER_BITS) > YAK_KW_BITS) {
+			fprintf(stderr, "ERROR: with -M, 2*k plus max(-p,%d) should be at most %d\n", YAK_COUNTER_BITS, YAK_KW_BITS);
+			return 1;
+		}
+		if (to_cuckoo) {
+			fprintf(stderr, "ERROR: -C can't be used with -M; lookups can't find the minimizer of a hashed k-mer\n");
+			return 1;
+		}
+		opt.flag |= YAK_F_MINIMIZER;
+	}
+	if (opt.hpc && (seed || opt.mz > 0 || (opt.flag & YAK_F_SHARED))) {
+		fprintf(stderr, "ERROR: -c can't be used with -S, -M or -g\n");
+		return 1;
+	}
+	if (opt.strand < 0 || opt.strand > 2) {
+		fprintf(stderr, "ERROR: -r should be 0, 1 or 2\n");
+		return 1;
+	}
+	if (opt.strand == 2) {
+		if (opt.mz > 0 || max_k * 2 >= YAK_KW_BITS || YAK_SC_BITS < 1) {
+			fprintf(stderr, "ERROR: -r2 can't be used with -M and requires k<%d\n", YAK_KW_BITS / 2);
+			return 1;
+		}
+		opt.flag |= YAK_F_STRANDED;
+	}
+	if ((opt.flag & YAK_F_SHARED) && (opt.bf_shift > 0 || (opt.flag & YAK_F_COMPACT))) {
+		fprintf(stderr, "ERROR: -S can't be used with -b or -Q\n");
+		return 1;
+	}
+	if (YAK_KW_BITS > 64 && ((opt.flag & (YAK_F_COMPACT|YAK_F_SHARED)) || to_cuckoo)) {
+		fprintf(stderr, "ERROR: -Q, -S and -C are not available with %d-bit k-mers\n", YAK_KW_BITS);
+		return 1;
+	}
+	if ((opt.flag & YAK_F_PRESIZE) && opt.bf_shift > 0)
+		fprintf(stderr, "[W::%s] -P is ignored with the Bloom filter\n", __func__);
+	if (max_cnt < 1) {
+		fprintf(stderr, "ERROR: -m should be positive\n");
+		return 1;
+	}
+	if (opt.min_q < 0 || opt.min_q > 93) {
+		fprintf(stderr, "ERROR: -q should be in [0,93]\n");
 		return 1;
 	}
+	if (est_only) return yak_print_est(argv[o.ind], &opt);
 	h = yak_count_file(argv[o.ind], argc - o.ind >= 2? argv[o.ind+1] : argv[o.ind], &opt);
-	fprintf(stderr, "[M::%s] %ld distinct k-mers after shrinking\n", __func__, (long)h->tot);
-	int i;
-	int64_t cnt[YAK_N_COUNTS];
-	yak_ch_hist(h, cnt, opt.n_thread);
-	for (i = 1; i < YAK_N_COUNTS; ++i) printf("%d\t%lld\n", i, (long long)cnt[i]);
-	yak_ch_destroy(h);
+	if (h == 0) {
+		fprintf(stderr, "ERROR: failed to open the input file(s)\n");
+		return 1;
+	}
+	for (t = 0; t < opt.n_k; ++t) {
+		fprintf(stderr, "[M::%s] %ld distinct %d-mers after shrinking\n", __func__, (long)h[t]->tot, opt.k[t]);
+		fprintf(stderr, "[M::%s] %.3f GB taken by %d-mer hash tables\n", __func__, yak_ch_mem(h[t]) / 1073741824.0, opt.k[t]);
+		if (to_cuckoo) {
+			yak_ch_cuckoo(h[t], opt.n_thread);
+			fprintf(stderr, "[M::%s] %.3f GB taken by %d-mer bucketized cuckoo hash tables\n", __func__, yak_ch_mem(h[t]) / 1073741824.0, opt.k[t]);
+		}
+	}
+	if (yak_huge_mem() >= 0)
+		fprintf(stderr, "[M::%s] %.3f GB on transparent huge pages\n", __func__, yak_huge_mem() / 1073741824.0);
+	n_col = opt.strand == 2? 3 : 1;
+	CALLOC(cnt, (max_cnt + 1) * n_col * opt.n_k);
+	for (t = 0; t < opt.n_k; ++t) {
+		int64_t *ct = &cnt[t * n_col * (max_cnt + 1)];
+		yak_ch_hist(h[t], max_cnt + 1, ct, opt.n_thread);
+		if (n_col == 3) // k-mers with a zero count on one strand
+			fprintf(stderr, "[M::%s] %lld %d-mers on the forward strand only; %lld on the reverse strand only\n", __func__,
+					(long long)ct[(max_cnt + 1) * 2], opt.k[t], (long long)ct[max_cnt + 1]);
+		yak_ch_destroy(h[t]);
+	}
+	for (i = 1; i <= max_cnt; ++i) { // one column per k-mer size; with -r2, total, forward and reverse counts per size
+		printf("%d", i);
+		for (t = 0; t < opt.n_k * n_col; ++t)
+			printf("\t%lld", (long long)cnt[t * (max_cnt + 1) + i]);
+		putchar('\n');
+	}
+	free(cnt); free(h);
 	return 0;
 }